@@ -0,0 +1,333 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*	Encode and decode time per framelet for all packet encoders on the host
+ *	(x86 timestamp counter, otherwise ns), for clean framelets and framelets
+ *	with errors the decoder has to correct. The fused 8b10b encoder is checked
+ *	against and compared to crc32, copy and dottedline’s encoder. Streaming
+ *	decoders are timed separately: the work per fifo block and what is left
+ *	at end of message.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <8b10b.h>
+
+#include "fmac.h"
+#include "packet.h"
+#include "crc32.h"
+#include "config.h"
+
+/* runin and tsi are stripped by the tda */
+#define PREAMBLE_BITS (24)
+
+/* decoder messages are not interesting here */
+int SEGGER_RTT_printf (unsigned int buffer, const char * fmt, ...) {
+	return 0;
+}
+
+#if PACKET_CRC_BITS == 32
+/*	The 8b10b encoder before it was fused with crc32: crc over a copy of the
+ *	message, then the library’s encoder
+ */
+static size_t referenceEncode (const uint8_t * const src, const size_t srcLen,
+		uint8_t * const dest, const size_t destLen) {
+	uint8_t raw[FMAC_MAX_PACKET_LEN];
+	const size_t rawSize = (1+srcLen+3)/4*4+sizeof (uint32_t);
+	const size_t bodySize = rawSize - sizeof (uint32_t);
+	assert (rawSize <= sizeof (raw));
+	assert (PREAMBLE_BITS/8+rawSize*10/8+1 <= destLen);
+
+	dest[0] = 0xaa;
+	dest[1] = 0x9a;
+	dest[2] = 0x69;
+	raw[0] = srcLen;
+	memcpy (&raw[1], src, srcLen);
+	memset (&raw[1+srcLen], 0, bodySize-1-srcLen);
+	const uint32_t crc32 = crc32Calc ((const uint32_t * const) raw, bodySize);
+	memcpy (&raw[bodySize], &crc32, sizeof (crc32));
+
+	eightbtenbCtx linecode;
+	eightbtenbInit (&linecode);
+	eightbtenbSetDest (&linecode, &dest[PREAMBLE_BITS/8]);
+	eightbtenbEncode (&linecode, raw, rawSize);
+	dest[PREAMBLE_BITS/8+rawSize*10/8] = 0;
+
+	return PREAMBLE_BITS+rawSize*10+8;
+}
+
+static void referenceInit (packetEncoder * const enc) {
+	packet8b10bInit (enc);
+	enc->encode = referenceEncode;
+}
+#endif
+
+static const struct {
+	const char *name;
+	void (*init) (packetEncoder * const enc);
+	/* bits flipped for the corrected column, one bit for crc correction, four
+	 * bytes in a row for rs */
+	unsigned int errorBits, errorStride;
+} encoders[] = {
+	{"identity", packetIdentityInit, 1, 0},
+#if PACKET_CRC_BITS == 32
+	{"8b10b-ref", referenceInit, 1, 0},
+#endif
+	{"8b10b", packet8b10bInit, 1, 0},
+	{"rs", packetRsInit, 4, 8},
+	{"scrambled", packetScrambledInit, 1, 0},
+	};
+
+/*	Flip error pattern starting at bit
+ */
+static void corrupt (uint8_t * const rx, const size_t bit, const size_t count,
+		const size_t stride) {
+	for (unsigned int i = 0; i < count; i++) {
+		const size_t b = bit + i*stride;
+		rx[b/8] ^= 1 << (b%8);
+	}
+}
+
+static bool decodes (const packetEncoder * const enc, const uint8_t * const rx,
+		const size_t bits, const uint8_t * const expect, const size_t expectLen) {
+	uint8_t dec[FMAC_MAX_PACKET_LEN];
+	size_t len;
+	return enc->decode (rx, bits, dec, sizeof (dec), &len) == PACKET_DECODE_OK &&
+			len == expectLen && memcmp (dec, expect, len) == 0;
+}
+
+static uint64_t now (void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc ();
+#else
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec*1000000000 + ts.tv_nsec;
+#endif
+}
+
+/*	Best of several runs of iterations decodes, against interrupts and
+ *	frequency scaling
+ */
+static double timeDecode (const packetEncoder * const enc,
+		const uint8_t * const rx, const size_t bits,
+		const uint8_t * const expect, const size_t expectLen) {
+	static const unsigned int iterations = 20000;
+	double best = 1e12;
+	for (unsigned int run = 0; run < 5; run++) {
+		const uint64_t start = now ();
+		for (unsigned int i = 0; i < iterations; i++) {
+			if (!decodes (enc, rx, bits, expect, expectLen)) {
+				return -1;
+			}
+		}
+		const double t = (double) (now () - start)/iterations;
+		if (t < best) {
+			best = t;
+		}
+	}
+	return best;
+}
+
+#if PACKET_CRC_BITS == 32
+/*	Fused encoder output must be bit-identical to the reference
+ */
+static bool verify (void) {
+	packetEncoder fused, ref;
+	packet8b10bInit (&fused);
+	referenceInit (&ref);
+	for (unsigned int i = 0; i < 1000; i++) {
+		for (size_t len = 1; len <= FMAC_MAX_BODY_LEN; len++) {
+			uint8_t body[FMAC_MAX_BODY_LEN];
+			for (size_t j = 0; j < len; j++) {
+				body[j] = rand ();
+			}
+			uint8_t a[FMAC_MAX_PACKET_LEN], b[FMAC_MAX_PACKET_LEN];
+			const size_t bitsA = fused.encode (body, len, a, sizeof (a));
+			const size_t bitsB = ref.encode (body, len, b, sizeof (b));
+			if (bitsA != bitsB || memcmp (a, b, (bitsA+7)/8) != 0) {
+				fprintf (stderr, "fused 8b10b mismatch, len %zu\n", len);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+#endif
+
+/*	Time streamPush for all blocks of a framelet and streamEnd separately,
+ *	best of several runs
+ */
+static void timeStream (const packetEncoder * const enc,
+		const uint8_t * const rx, const size_t bits,
+		const uint8_t * const expect, const size_t expectLen,
+		double * const pushTime, double * const endTime) {
+	static const unsigned int iterations = 20000;
+	*pushTime = 1e12;
+	*endTime = 1e12;
+	for (unsigned int run = 0; run < 5; run++) {
+		uint64_t push = 0, end = 0;
+		for (unsigned int i = 0; i < iterations; i++) {
+			packetStream s;
+			uint8_t dec[FMAC_MAX_PACKET_LEN];
+			size_t len;
+			const uint64_t start = now ();
+			enc->streamBegin (&s, dec, sizeof (dec));
+			for (size_t pos = 0; pos < bits; pos += 32) {
+				const size_t n = bits-pos < 32 ? bits-pos : 32;
+				uint32_t block = 0;
+				memcpy (&block, &rx[pos/8], (n+7)/8);
+				enc->streamPush (&s, block, n);
+			}
+			const uint64_t mid = now ();
+			if (enc->streamEnd (&s, &len) != PACKET_DECODE_OK ||
+					len != expectLen || memcmp (dec, expect, len) != 0) {
+				fprintf (stderr, "stream decoding failed\n");
+				exit (EXIT_FAILURE);
+			}
+			end += now () - mid;
+			push += mid - start;
+		}
+		if ((double) push/iterations < *pushTime) {
+			*pushTime = (double) push/iterations;
+		}
+		if ((double) end/iterations < *endTime) {
+			*endTime = (double) end/iterations;
+		}
+	}
+}
+
+int main (int argc, char **argv) {
+	/* a 15 byte payload and the longest body */
+	static const size_t sizes[] = {FMAC_HEADER_LEN+15, FMAC_MAX_BODY_LEN};
+	volatile size_t sink = 0;
+
+	packetCrcInit ();
+	/* the reference only knows crc32 */
+#if PACKET_CRC_BITS == 32
+	if (!verify ()) {
+		return EXIT_FAILURE;
+	}
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+	const char * const unit = "cycles";
+#else
+	const char * const unit = "ns";
+#endif
+	printf ("%-10s %4s %5s %8s %8s %9s  (%s/framelet)\n", "encoder", "body",
+			"bytes", "encode", "decode", "corrected", unit);
+
+	for (size_t e = 0; e < sizeof (encoders)/sizeof (*encoders); e++) {
+		packetEncoder enc;
+		encoders[e].init (&enc);
+
+		for (size_t s = 0; s < sizeof (sizes)/sizeof (*sizes); s++) {
+			const size_t bodyLen = sizes[s];
+			uint8_t body[FMAC_MAX_BODY_LEN];
+			for (size_t i = 0; i < bodyLen; i++) {
+				body[i] = rand ();
+			}
+
+			static const unsigned int iterations = 20000;
+			uint8_t tx[FMAC_MAX_PACKET_LEN];
+			size_t txBits = 0;
+			double encodeTime = 1e12;
+			for (unsigned int run = 0; run < 5; run++) {
+				const uint64_t start = now ();
+				for (unsigned int i = 0; i < iterations; i++) {
+					txBits = enc.encode (body, bodyLen, tx, sizeof (tx));
+					sink ^= txBits;
+				}
+				const double t = (double) (now () - start)/iterations;
+				if (t < encodeTime) {
+					encodeTime = t;
+				}
+			}
+
+			const size_t bits = txBits - PREAMBLE_BITS;
+			uint8_t rx[FMAC_MAX_PACKET_LEN];
+			memcpy (rx, &tx[PREAMBLE_BITS/8], (bits+7)/8);
+			const double cleanTime = timeDecode (&enc, rx, bits, body, bodyLen);
+			if (cleanTime < 0) {
+				fprintf (stderr, "%s: decoding failed\n", encoders[e].name);
+				return EXIT_FAILURE;
+			}
+			/* first error from the middle of the packet on the decoder
+			 * recovers from, most single bit errors are 8b10b symbol errors */
+			const size_t count = encoders[e].errorBits,
+					stride = encoders[e].errorStride;
+			double corruptTime = -1;
+			for (size_t bit = bits/2; bit + (count-1)*stride < bits; bit++) {
+				corrupt (rx, bit, count, stride);
+				if (decodes (&enc, rx, bits, body, bodyLen)) {
+					corruptTime = timeDecode (&enc, rx, bits, body, bodyLen);
+					break;
+				}
+				corrupt (rx, bit, count, stride);
+			}
+
+			printf ("%-10s %4zu %5zu %8.0f %8.0f %9.0f\n", encoders[e].name,
+					bodyLen, enc.txlen (bodyLen), encodeTime, cleanTime,
+					corruptTime);
+		}
+	}
+
+	printf ("\n%-10s %4s %8s %8s %8s  (%s/framelet)\n", "stream", "body",
+			"push", "eom", "batch", unit);
+	for (size_t e = 0; e < sizeof (encoders)/sizeof (*encoders); e++) {
+		packetEncoder enc;
+		encoders[e].init (&enc);
+		/* the reference only differs in the encoder */
+		if (enc.streamBegin == NULL || strcmp (encoders[e].name, "8b10b-ref") == 0) {
+			continue;
+		}
+		for (size_t s = 0; s < sizeof (sizes)/sizeof (*sizes); s++) {
+			const size_t bodyLen = sizes[s];
+			uint8_t body[FMAC_MAX_BODY_LEN];
+			for (size_t i = 0; i < bodyLen; i++) {
+				body[i] = rand ();
+			}
+			uint8_t tx[FMAC_MAX_PACKET_LEN];
+			const size_t bits = enc.encode (body, bodyLen, tx, sizeof (tx)) -
+					PREAMBLE_BITS;
+			uint8_t rx[FMAC_MAX_PACKET_LEN+4];
+			memset (rx, 0, sizeof (rx));
+			memcpy (rx, &tx[PREAMBLE_BITS/8], (bits+7)/8);
+			double pushTime, endTime;
+			timeStream (&enc, rx, bits, body, bodyLen, &pushTime, &endTime);
+			printf ("%-10s %4zu %8.0f %8.0f %8.0f\n", encoders[e].name, bodyLen,
+					pushTime, endTime, timeDecode (&enc, rx, bits, body, bodyLen));
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,140 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*	Check all crc32 variants against the bytewise reference and report their
+ *	speed on the host in cycles/byte (x86 timestamp counter, otherwise ns/byte).
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "crc32.h"
+
+typedef uint32_t (*crcFunc) (const void * const buf, const size_t len);
+
+static uint32_t slice4 (const void * const buf, const size_t len) {
+	return crc32Slice4 (buf, len);
+}
+
+static uint32_t slice8 (const void * const buf, const size_t len) {
+	return crc32Slice8 (buf, len);
+}
+
+static const struct {
+	const char *name;
+	crcFunc f;
+	/* table size in bytes */
+	size_t tableSize;
+} variants[] = {
+	{"bytewise", crc32Bytewise, 256*4},
+	{"nibble", crc32Nibble, 2*16*4},
+	{"slice4", slice4, 4*256*4},
+	{"slice8", slice8, 8*256*4},
+	};
+
+static uint64_t now (void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc ();
+#else
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec*1000000000 + ts.tv_nsec;
+#endif
+}
+
+static bool verify (void) {
+	uint8_t buf[256+8];
+	for (size_t i = 0; i < sizeof (buf); i++) {
+		buf[i] = rand ();
+	}
+	for (size_t off = 0; off < 8; off++) {
+		for (size_t len = 0; len <= 256; len++) {
+			const uint32_t expect = crc32Bytewise (&buf[off], len);
+			for (size_t v = 1; v < sizeof (variants)/sizeof (*variants); v++) {
+				const uint32_t got = variants[v].f (&buf[off], len);
+				if (got != expect) {
+					fprintf (stderr, "%s mismatch, offset %zu, len %zu: %08x != %08x\n",
+							variants[v].name, off, len, got, expect);
+					return false;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+int main (int argc, char **argv) {
+	/* framelet of a 16 byte packet, the longest framelet, a large buffer */
+	static const size_t sizes[] = {24, 68, 4096};
+	static uint8_t buf[4096];
+	volatile uint32_t sink = 0;
+
+	crc32SliceInit ();
+	if (!verify ()) {
+		return EXIT_FAILURE;
+	}
+	for (size_t i = 0; i < sizeof (buf); i++) {
+		buf[i] = rand ();
+	}
+
+#if defined(__x86_64__) || defined(__i386__)
+	const char * const unit = "cycles/byte";
+#else
+	const char * const unit = "ns/byte";
+#endif
+	printf ("%-10s %6s", "variant", "table");
+	for (size_t s = 0; s < sizeof (sizes)/sizeof (*sizes); s++) {
+		printf (" %6zu B", sizes[s]);
+	}
+	printf ("  (%s)\n", unit);
+
+	for (size_t v = 0; v < sizeof (variants)/sizeof (*variants); v++) {
+		printf ("%-10s %6zu", variants[v].name, variants[v].tableSize);
+		for (size_t s = 0; s < sizeof (sizes)/sizeof (*sizes); s++) {
+			const size_t len = sizes[s];
+			const unsigned int iterations = (1<<24)/len;
+			/* best of several runs, against interrupts and frequency scaling */
+			double best = 1e9;
+			for (unsigned int run = 0; run < 5; run++) {
+				const uint64_t start = now ();
+				for (unsigned int i = 0; i < iterations; i++) {
+					sink ^= variants[v].f (buf, len);
+				}
+				const double perByte = (double) (now () - start)/iterations/len;
+				if (perByte < best) {
+					best = perByte;
+				}
+			}
+			printf (" %8.2f", best);
+		}
+		printf ("\n");
+	}
+
+	return EXIT_SUCCESS;
+}
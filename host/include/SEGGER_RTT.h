@@ -0,0 +1,39 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/* enabled by the simulator’s -v flag */
+extern bool simVerbose;
+
+int SEGGER_RTT_printf (unsigned int buffer, const char * fmt, ...);
+unsigned int SEGGER_RTT_Write (unsigned int buffer, const void * data,
+		unsigned int size);
+unsigned int SEGGER_RTT_WriteString (unsigned int buffer, const char * s);
+
+#define SEGGER_RTT_MODE_NO_BLOCK_SKIP (0)
+
+int SEGGER_RTT_ConfigUpBuffer (unsigned int buffer, const char * name,
+		void * data, unsigned int size, unsigned int flags);
@@ -0,0 +1,77 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*	Simulated TDA5340 transceiver, see host/simhal.c. Callbacks are invoked
+ *	from the simulator’s event loop instead of the chip’s interrupt.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "tda5340_reg.h"
+
+typedef enum {
+	TDA_SLEEP_MODE,
+	TDA_RUN_MODE_SLAVE,
+	TDA_TRANSMIT_MODE,
+} tda5340Mode;
+
+typedef enum {
+	TDA_CONFIG_A,
+	TDA_CONFIG_B,
+} tda5340Config;
+
+typedef struct {
+	uint8_t reg;
+	uint32_t val;
+} tdaConfigVal;
+
+typedef struct tda5340Ctx tda5340Ctx;
+
+typedef void (*tda5340Callback) (tda5340Ctx * const tda, void * const data);
+
+struct tda5340Ctx {
+	volatile tda5340Mode mode;
+	bool fsInitFifo;
+
+	tda5340Callback txready, txempty, txerror, rxeom;
+	void *data;
+
+	/* simulator state */
+	void *sim;
+	uint32_t reg[TDA_REG_COUNT];
+};
+
+bool tda5340ModeSet (tda5340Ctx * const tda, const tda5340Mode mode,
+		const bool selfPolling, const tda5340Config config);
+bool tda5340RegWrite (tda5340Ctx * const tda, const uint8_t reg,
+		const uint32_t val);
+bool tda5340RegWriteBulk (tda5340Ctx * const tda,
+		const tdaConfigVal * const config, const size_t size);
+void tda5340FifoWrite (tda5340Ctx * const tda, const void * const data,
+		const size_t bits);
+bool tda5340FifoRead (tda5340Ctx * const tda, uint32_t * const block,
+		uint8_t * const bits);
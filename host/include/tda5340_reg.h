@@ -0,0 +1,70 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*	Register names used by the MAC. Values are arbitrary, the simulator only
+ *	looks at the data length and baud rate.
+ */
+
+#pragma once
+
+typedef enum {
+	TDA_XTALCAL0,
+	TDA_XTALCAL1,
+	TDA_PLLCFG,
+	TDA_IM0,
+	TDA_IM2,
+	TDA_A_TXCFG,
+	TDA_A_TXPOWER0,
+	TDA_A_TXPOWER1,
+	TDA_A_TXFREQ,
+	TDA_A_TXBAUDRATE,
+	TDA_B_IF1,
+	TDA_B_SYSRCTO,
+	TDA_B_DIGRXC,
+	TDA_B_PDECSCASK,
+	TDA_B_CDRCFG0,
+	TDA_B_SLCCFG,
+	TDA_B_CHCFG,
+	TDA_B_TVWIN,
+	TDA_B_RXFREQ,
+	TDA_B_RXBAUDRATE,
+	TDA_B_TSILENA,
+	TDA_B_EOMC,
+	TDA_B_EOMDLEN,
+	TDA_B_TSIPTA0,
+	TDA_B_TSIPTA1,
+	TDA_B_AFCSFCFG,
+	TDA_B_AFCKCFG0,
+	TDA_B_AFCKCFG1,
+	TDA_REG_COUNT,
+} tdaRegister;
+
+#define TDA_IM0_FSYNCB_OFF (4)
+#define TDA_IM0_EOMB_OFF (6)
+#define TDA_IM2_TXEMPTY_OFF (2)
+#define TDA_IM2_TXREADY_OFF (3)
+
+/* frequency in 100 kHz, baud rate in kbit/s */
+#define TDA_CFG_TXFREQ(cfg, f) {TDA_##cfg##_TXFREQ, (f)}
+#define TDA_CFG_RXFREQ(cfg, f) {TDA_##cfg##_RXFREQ, (f)}
+#define TDA_CFG_TXBAUDRATE(cfg, b) {TDA_##cfg##_TXBAUDRATE, (b)}
+#define TDA_CFG_RXBAUDRATE(cfg, b) {TDA_##cfg##_RXBAUDRATE, (b)}
@@ -0,0 +1,174 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*	Simulated CCU4 timer module. Each simulated station owns one module,
+ *	CCU40 points to the module of the station currently running.
+ */
+
+#pragma once
+
+#include "xmc_common.h"
+
+typedef enum {
+	XMC_CCU4_SLICE_PRESCALER_1 = 0,
+	XMC_CCU4_SLICE_PRESCALER_2,
+	XMC_CCU4_SLICE_PRESCALER_4,
+	XMC_CCU4_SLICE_PRESCALER_8,
+	XMC_CCU4_SLICE_PRESCALER_16,
+	XMC_CCU4_SLICE_PRESCALER_32,
+	XMC_CCU4_SLICE_PRESCALER_64,
+	XMC_CCU4_SLICE_PRESCALER_128,
+} XMC_CCU4_SLICE_PRESCALER_t;
+
+typedef enum {
+	XMC_CCU4_SLICE_TIMER_COUNT_MODE_EA,
+	XMC_CCU4_SLICE_TIMER_COUNT_MODE_CA,
+} XMC_CCU4_SLICE_TIMER_COUNT_MODE_t;
+
+typedef enum {
+	XMC_CCU4_SLICE_TIMER_REPEAT_MODE_REPEAT,
+	XMC_CCU4_SLICE_TIMER_REPEAT_MODE_SINGLE,
+} XMC_CCU4_SLICE_TIMER_REPEAT_MODE_t;
+
+typedef enum {
+	XMC_CCU4_SLICE_PRESCALER_MODE_NORMAL,
+	XMC_CCU4_SLICE_PRESCALER_MODE_FLOAT,
+} XMC_CCU4_SLICE_PRESCALER_MODE_t;
+
+typedef enum {
+	XMC_CCU4_SLICE_OUTPUT_PASSIVE_LEVEL_LOW,
+	XMC_CCU4_SLICE_OUTPUT_PASSIVE_LEVEL_HIGH,
+} XMC_CCU4_SLICE_OUTPUT_PASSIVE_LEVEL_t;
+
+typedef enum {
+	XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH = 0,
+	XMC_CCU4_SLICE_IRQ_ID_ONE_MATCH = 1,
+	XMC_CCU4_SLICE_IRQ_ID_COMPARE_MATCH_UP = 2,
+	XMC_CCU4_SLICE_IRQ_ID_COMPARE_MATCH_DOWN = 3,
+} XMC_CCU4_SLICE_IRQ_ID_t;
+
+typedef enum {
+	XMC_CCU4_SLICE_SR_ID_0,
+	XMC_CCU4_SLICE_SR_ID_1,
+	XMC_CCU4_SLICE_SR_ID_2,
+	XMC_CCU4_SLICE_SR_ID_3,
+} XMC_CCU4_SLICE_SR_ID_t;
+
+typedef enum {
+	XMC_CCU4_SHADOW_TRANSFER_SLICE_0 = 1U<<0,
+	XMC_CCU4_SHADOW_TRANSFER_SLICE_1 = 1U<<4,
+	XMC_CCU4_SHADOW_TRANSFER_SLICE_2 = 1U<<8,
+	XMC_CCU4_SHADOW_TRANSFER_SLICE_3 = 1U<<12,
+} XMC_CCU4_SHADOW_TRANSFER_t;
+
+typedef enum {
+	XMC_CCU4_CLOCK_SCU,
+} XMC_CCU4_CLOCK_t;
+
+typedef enum {
+	XMC_CCU4_SLICE_MCMS_ACTION_TRANSFER_PR_CR,
+} XMC_CCU4_SLICE_MCMS_ACTION_t;
+
+typedef struct {
+	XMC_CCU4_SLICE_TIMER_COUNT_MODE_t timer_mode;
+	XMC_CCU4_SLICE_TIMER_REPEAT_MODE_t monoshot;
+	uint32_t shadow_xfer_clear;
+	uint32_t dither_timer_period;
+	uint32_t dither_duty_cycle;
+	XMC_CCU4_SLICE_PRESCALER_MODE_t prescaler_mode;
+	uint32_t mcm_enable;
+	uint32_t prescaler_initval;
+	uint32_t float_limit;
+	uint32_t dither_limit;
+	XMC_CCU4_SLICE_OUTPUT_PASSIVE_LEVEL_t passive_level;
+	uint32_t timer_concatenation;
+} XMC_CCU4_SLICE_COMPARE_CONFIG_t;
+
+typedef struct XMC_CCU4_MODULE XMC_CCU4_MODULE_t;
+
+typedef struct {
+	XMC_CCU4_MODULE_t *module;
+	uint8_t no;
+	bool running, concatenated;
+	XMC_CCU4_SLICE_TIMER_REPEAT_MODE_t monoshot;
+	uint8_t prescaler;
+	/* timer value at time ref (in ns) */
+	uint16_t timer;
+	double ref;
+	/* a period match happened during the last update */
+	bool wrapped;
+	/* active and shadow registers */
+	uint16_t compare, period, compareShadow, periodShadow;
+	bool transferPending;
+	/* enabled events, by XMC_CCU4_SLICE_IRQ_ID_t */
+	uint8_t events;
+} XMC_CCU4_SLICE_t;
+
+typedef void (*simCcu4Irq) (XMC_CCU4_MODULE_t * const module,
+		XMC_CCU4_SLICE_t * const slice, const XMC_CCU4_SLICE_IRQ_ID_t event);
+
+struct XMC_CCU4_MODULE {
+	XMC_CCU4_SLICE_t cc[4];
+	/* duration of one tick at prescaler 1 in ns, including clock drift */
+	double clockNs;
+	/* invalidates scheduled events */
+	uint32_t generation;
+	simCcu4Irq irq;
+	void *data;
+};
+
+extern XMC_CCU4_MODULE_t *simCcu4;
+
+#define CCU40 (simCcu4)
+#define CCU40_CC40 (&simCcu4->cc[0])
+#define CCU40_CC41 (&simCcu4->cc[1])
+#define CCU40_CC42 (&simCcu4->cc[2])
+#define CCU40_CC43 (&simCcu4->cc[3])
+
+void XMC_CCU4_SetModuleClock (XMC_CCU4_MODULE_t * const module,
+		const XMC_CCU4_CLOCK_t clock);
+void XMC_CCU4_Init (XMC_CCU4_MODULE_t * const module,
+		const XMC_CCU4_SLICE_MCMS_ACTION_t action);
+void XMC_CCU4_StartPrescaler (XMC_CCU4_MODULE_t * const module);
+void XMC_CCU4_EnableClock (XMC_CCU4_MODULE_t * const module, const uint8_t slice);
+void XMC_CCU4_EnableShadowTransfer (XMC_CCU4_MODULE_t * const module,
+		const uint32_t mask);
+
+void XMC_CCU4_SLICE_CompareInit (XMC_CCU4_SLICE_t * const slice,
+		const XMC_CCU4_SLICE_COMPARE_CONFIG_t * const config);
+void XMC_CCU4_SLICE_StartTimer (XMC_CCU4_SLICE_t * const slice);
+void XMC_CCU4_SLICE_StopTimer (XMC_CCU4_SLICE_t * const slice);
+void XMC_CCU4_SLICE_ClearTimer (XMC_CCU4_SLICE_t * const slice);
+bool XMC_CCU4_SLICE_IsTimerRunning (XMC_CCU4_SLICE_t * const slice);
+uint16_t XMC_CCU4_SLICE_GetTimerValue (XMC_CCU4_SLICE_t * const slice);
+void XMC_CCU4_SLICE_SetTimerCompareMatch (XMC_CCU4_SLICE_t * const slice,
+		const uint16_t value);
+void XMC_CCU4_SLICE_SetTimerPeriodMatch (XMC_CCU4_SLICE_t * const slice,
+		const uint16_t value);
+void XMC_CCU4_SLICE_EnableEvent (XMC_CCU4_SLICE_t * const slice,
+		const XMC_CCU4_SLICE_IRQ_ID_t event);
+void XMC_CCU4_SLICE_DisableEvent (XMC_CCU4_SLICE_t * const slice,
+		const XMC_CCU4_SLICE_IRQ_ID_t event);
+void XMC_CCU4_SLICE_ClearEvent (XMC_CCU4_SLICE_t * const slice,
+		const XMC_CCU4_SLICE_IRQ_ID_t event);
+void XMC_CCU4_SLICE_SetInterruptNode (XMC_CCU4_SLICE_t * const slice,
+		const XMC_CCU4_SLICE_IRQ_ID_t event, const XMC_CCU4_SLICE_SR_ID_t sr);
@@ -0,0 +1,71 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*	Host stand-in for the parts of xmclib used by the MAC, see host/simhal.c
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#define XMC11 (11)
+#define XMC45 (45)
+/* the simulator models the XMC4500 relax kit */
+#define UC_SERIES XMC45
+
+typedef enum {
+	CCU40_0_IRQn,
+	CCU40_1_IRQn,
+	USIC1_0_IRQn,
+} IRQn_Type;
+
+inline static void NVIC_SetPriority (const IRQn_Type irq, const uint32_t prio) {
+}
+
+inline static void NVIC_EnableIRQ (const IRQn_Type irq) {
+}
+
+inline static uint32_t NVIC_GetPriorityGrouping (void) {
+	return 0;
+}
+
+inline static uint32_t NVIC_EncodePriority (const uint32_t group,
+		const uint32_t preempt, const uint32_t sub) {
+	return preempt;
+}
+
+/* interrupt handlers run to completion in the simulator */
+inline static void __disable_irq (void) {
+}
+
+inline static void __enable_irq (void) {
+}
+
+inline static uint32_t __get_PRIMASK (void) {
+	return 0;
+}
+
+inline static void __set_PRIMASK (const uint32_t primask) {
+}
@@ -0,0 +1,88 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include "xmc_common.h"
+
+/* pins are (port, pin) pairs, like the real ones */
+typedef struct {
+	uint32_t out;
+} XMC_GPIO_PORT_t;
+
+extern XMC_GPIO_PORT_t simGpioPort[3];
+
+#define P0_0 (&simGpioPort[0]), 0
+#define P0_4 (&simGpioPort[0]), 4
+#define P0_5 (&simGpioPort[0]), 5
+#define P0_6 (&simGpioPort[0]), 6
+#define P0_11 (&simGpioPort[0]), 11
+#define P0_12 (&simGpioPort[0]), 12
+#define P1_0 (&simGpioPort[1]), 0
+#define P1_1 (&simGpioPort[1]), 1
+#define P2_1 (&simGpioPort[2]), 1
+
+typedef enum {
+	XMC_GPIO_MODE_INPUT_TRISTATE,
+	XMC_GPIO_MODE_OUTPUT_PUSH_PULL,
+	XMC_GPIO_MODE_OUTPUT_PUSH_PULL_ALT2,
+} XMC_GPIO_MODE_t;
+
+typedef enum {
+	XMC_GPIO_OUTPUT_LEVEL_LOW,
+	XMC_GPIO_OUTPUT_LEVEL_HIGH,
+} XMC_GPIO_OUTPUT_LEVEL_t;
+
+typedef enum {
+	XMC_GPIO_HWCTRL_DISABLED,
+} XMC_GPIO_HWCTRL_t;
+
+typedef struct {
+	XMC_GPIO_MODE_t mode;
+	XMC_GPIO_OUTPUT_LEVEL_t output_level;
+} XMC_GPIO_CONFIG_t;
+
+inline static void XMC_GPIO_Init (XMC_GPIO_PORT_t * const port,
+		const uint8_t pin, const XMC_GPIO_CONFIG_t * const config) {
+	if (config->output_level == XMC_GPIO_OUTPUT_LEVEL_HIGH) {
+		port->out |= 1U<<pin;
+	}
+}
+
+inline static void XMC_GPIO_SetHardwareControl (XMC_GPIO_PORT_t * const port,
+		const uint8_t pin, const XMC_GPIO_HWCTRL_t hwctrl) {
+}
+
+inline static void XMC_GPIO_ToggleOutput (XMC_GPIO_PORT_t * const port,
+		const uint8_t pin) {
+	port->out ^= 1U<<pin;
+}
+
+inline static void XMC_GPIO_SetOutputHigh (XMC_GPIO_PORT_t * const port,
+		const uint8_t pin) {
+	port->out |= 1U<<pin;
+}
+
+inline static void XMC_GPIO_SetOutputLow (XMC_GPIO_PORT_t * const port,
+		const uint8_t pin) {
+	port->out &= ~(1U<<pin);
+}
@@ -0,0 +1,107 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*	Simulated USIC channel in SPI slave mode, see xmc_usic.h
+ */
+
+#pragma once
+
+#include "xmc_usic.h"
+
+typedef enum {
+	XMC_SPI_CH_BUS_MODE_SLAVE,
+} XMC_SPI_CH_BUS_MODE_t;
+
+typedef enum {
+	XMC_USIC_CH_PARITY_MODE_NONE,
+} XMC_USIC_CH_PARITY_MODE_t;
+
+typedef struct {
+	XMC_SPI_CH_BUS_MODE_t bus_mode;
+	XMC_USIC_CH_PARITY_MODE_t parity_mode;
+} XMC_SPI_CH_CONFIG_t;
+
+typedef enum {
+	XMC_SPI_CH_INPUT_DIN0,
+	XMC_SPI_CH_INPUT_SLAVE_SCLKIN,
+	XMC_SPI_CH_INPUT_SLAVE_SELIN,
+} XMC_SPI_CH_INPUT_t;
+
+typedef enum {
+	XMC_SPI_CH_MODE_STANDARD,
+} XMC_SPI_CH_MODE_t;
+
+typedef enum {
+	XMC_SPI_CH_STATUS_FLAG_DX2T_EVENT_DETECTED = 1U<<12,
+	XMC_SPI_CH_STATUS_FLAG_DATA_LOST_INDICATION = 1U<<14,
+} XMC_SPI_CH_STATUS_FLAG_t;
+
+typedef enum {
+	XMC_SPI_CH_EVENT_DX2TIEN_ACTIVATED = 1U<<12,
+} XMC_SPI_CH_EVENT_t;
+
+inline static void XMC_SPI_CH_Init (XMC_USIC_CH_t * const channel,
+		const XMC_SPI_CH_CONFIG_t * const config) {
+}
+
+inline static void XMC_SPI_CH_Start (XMC_USIC_CH_t * const channel) {
+}
+
+inline static void XMC_SPI_CH_SetInputSource (XMC_USIC_CH_t * const channel,
+		const XMC_SPI_CH_INPUT_t input, const uint8_t source) {
+}
+
+inline static void XMC_SPI_CH_EnableInputInversion (
+		XMC_USIC_CH_t * const channel, const XMC_SPI_CH_INPUT_t input) {
+}
+
+inline static void XMC_SPI_CH_SetBitOrderMsbFirst (
+		XMC_USIC_CH_t * const channel) {
+}
+
+inline static void XMC_SPI_CH_Receive (XMC_USIC_CH_t * const channel,
+		const XMC_SPI_CH_MODE_t mode) {
+}
+
+inline static void XMC_SPI_CH_EnableEvent (XMC_USIC_CH_t * const channel,
+		const uint32_t event) {
+	channel->events |= event;
+}
+
+inline static uint32_t XMC_SPI_CH_GetStatusFlag (XMC_USIC_CH_t * const channel) {
+	return channel->status;
+}
+
+inline static void XMC_SPI_CH_ClearStatusFlag (XMC_USIC_CH_t * const channel,
+		const uint32_t flag) {
+	channel->status &= ~flag;
+}
+
+inline static void XMC_SPI_CH_DisableDataTransmission (
+		XMC_USIC_CH_t * const channel) {
+	channel->txDisabled = true;
+}
+
+inline static void XMC_SPI_CH_EnableDataTransmission (
+		XMC_USIC_CH_t * const channel) {
+	channel->txDisabled = false;
+}
@@ -0,0 +1,112 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*	Simulated USIC channel: 32 word transmit and receive fifo with the
+ *	transmit fifo’s standard event. The master side is driven by host/spisim.c
+ *	through the simUsic* functions.
+ */
+
+#pragma once
+
+#include "xmc_common.h"
+
+#define SIM_USIC_FIFO_SIZE (32)
+/* fifo entries with this bit set are break symbols (FLE mode, uart) */
+#define SIM_USIC_BREAK (1U<<16)
+
+typedef enum {
+	XMC_USIC_CH_FIFO_SIZE_32WORDS = 5,
+} XMC_USIC_CH_FIFO_SIZE_t;
+
+typedef enum {
+	XMC_USIC_CH_TXFIFO_EVENT_CONF_STANDARD = 1U<<30,
+} XMC_USIC_CH_TXFIFO_EVENT_CONF_t;
+
+typedef enum {
+	XMC_USIC_CH_TXFIFO_EVENT_STANDARD = 1U<<8,
+} XMC_USIC_CH_TXFIFO_EVENT_t;
+
+typedef enum {
+	XMC_USIC_CH_TXFIFO_INTERRUPT_NODE_POINTER_STANDARD,
+} XMC_USIC_CH_TXFIFO_INTERRUPT_NODE_POINTER_t;
+
+#define USIC_CH_DX2CR_CM_Pos (10)
+#define USIC_CH_DX2CR_CM_Msk (0x3U << USIC_CH_DX2CR_CM_Pos)
+
+/* input sources, ignored */
+#define USIC1_C0_DX0_P0_4 (0)
+#define USIC1_C0_DX1_P0_11 (0)
+#define USIC1_C0_DX2_P0_6 (0)
+
+typedef struct {
+	uint32_t DXCR[6];
+	/* transmit fifo, a ring of level entries starting at txRead */
+	uint32_t tx[SIM_USIC_FIFO_SIZE];
+	unsigned int txRead, txLevel, txLimit;
+	/* standard event enabled and raised */
+	bool txEventEnabled;
+	uint32_t txEvents;
+	/* transmission disabled while the slave fills the fifo */
+	bool txDisabled;
+	uint8_t rx[SIM_USIC_FIFO_SIZE];
+	unsigned int rxRead, rxLevel;
+	/* protocol status flags and enabled protocol events */
+	uint32_t status, events;
+	/* the service request line is pending */
+	bool irq;
+	/* words the master clocked while the tx fifo was empty or disabled */
+	uint64_t underruns;
+} XMC_USIC_CH_t;
+
+void XMC_USIC_CH_TXFIFO_Configure (XMC_USIC_CH_t * const channel,
+		const uint32_t dataPointer, const XMC_USIC_CH_FIFO_SIZE_t size,
+		const uint32_t limit);
+void XMC_USIC_CH_RXFIFO_Configure (XMC_USIC_CH_t * const channel,
+		const uint32_t dataPointer, const XMC_USIC_CH_FIFO_SIZE_t size,
+		const uint32_t limit);
+void XMC_USIC_CH_TXFIFO_SetInterruptNodePointer (XMC_USIC_CH_t * const channel,
+		const XMC_USIC_CH_TXFIFO_INTERRUPT_NODE_POINTER_t node,
+		const uint32_t sr);
+void XMC_USIC_CH_TXFIFO_EnableEvent (XMC_USIC_CH_t * const channel,
+		const uint32_t event);
+void XMC_USIC_CH_TXFIFO_DisableEvent (XMC_USIC_CH_t * const channel,
+		const uint32_t event);
+uint32_t XMC_USIC_CH_TXFIFO_GetEvent (XMC_USIC_CH_t * const channel);
+void XMC_USIC_CH_TXFIFO_ClearEvent (XMC_USIC_CH_t * const channel,
+		const uint32_t event);
+void XMC_USIC_CH_TXFIFO_Flush (XMC_USIC_CH_t * const channel);
+bool XMC_USIC_CH_TXFIFO_IsFull (XMC_USIC_CH_t * const channel);
+void XMC_USIC_CH_TXFIFO_PutData (XMC_USIC_CH_t * const channel,
+		const uint16_t data);
+void XMC_USIC_CH_TXFIFO_PutDataFLEMode (XMC_USIC_CH_t * const channel,
+		const uint16_t data, const uint32_t frameLength);
+void XMC_USIC_CH_RXFIFO_Flush (XMC_USIC_CH_t * const channel);
+bool XMC_USIC_CH_RXFIFO_IsEmpty (XMC_USIC_CH_t * const channel);
+uint32_t XMC_USIC_CH_RXFIFO_GetLevel (XMC_USIC_CH_t * const channel);
+uint16_t XMC_USIC_CH_RXFIFO_GetData (XMC_USIC_CH_t * const channel);
+
+/* master side */
+void simUsicInit (XMC_USIC_CH_t * const channel);
+bool simUsicRequest (XMC_USIC_CH_t * const channel, const uint8_t * const data,
+		const size_t size, const uint32_t flag);
+bool simUsicClock (XMC_USIC_CH_t * const channel, uint32_t * const word);
+bool simUsicIrq (XMC_USIC_CH_t * const channel);
@@ -0,0 +1,135 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*	Offline k-set generator. Writes the table used by fmacInit to stdout or,
+ *	with -r, a report of the worst-case wait t'=(kmax*(n-1)+1)*δ per cell size.
+ *	The report covers all cell sizes fmacInit accepts; those beyond the table
+ *	use the greedy search, just like fmacInit, and are marked as such.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "kset.h"
+
+static void usage (const char * const name) {
+	fprintf (stderr, "Usage: %s [-n maxstations] [-r] [-d delta_us]\n", name);
+}
+
+static void writeTable (const uint8_t maxN) {
+	uint32_t k[KSET_MAX_N];
+	unsigned int off = 0;
+
+	printf ("/* generated by host/ksetgen, do not edit */\n\n"
+			"#pragma once\n\n"
+			"#include <stdint.h>\n\n"
+			"#define KSET_TABLE_MAX_N (%u)\n\n"
+			"/* collision-free k-sets with minimal kmax, see kset.c */\n"
+			"static const uint32_t ksetTable[] = {\n", maxN);
+	for (uint8_t n = 1; n <= maxN; n++) {
+		if (!ksetFind (k, n)) {
+			fprintf (stderr, "no k-set for n=%u\n", n);
+			exit (EXIT_FAILURE);
+		}
+		printf ("\t");
+		for (uint8_t j = 0; j < n; j++) {
+			printf ("%u, ", k[j]);
+		}
+		printf ("/* n=%u */\n", n);
+	}
+	printf ("\t};\n"
+			"static const uint16_t ksetTableOff[] = {\n"
+			"\t0, /* unused */\n");
+	for (uint8_t n = 1; n <= maxN; n++) {
+		printf ("\t%u, /* n=%u */\n", off, n);
+		off += n;
+	}
+	printf ("\t};\n");
+}
+
+static void writeReport (const uint8_t tableN, const unsigned int deltaUs) {
+	uint32_t k[KSET_MAX_N];
+
+	printf ("%3s %5s %8s", "n", "kmax", "t'/δ");
+	if (deltaUs != 0) {
+		printf (" %10s", "t'/ms");
+	}
+	printf (" %8s  k-set\n", "search");
+	for (uint8_t n = 1; n <= KSET_MAX_N; n++) {
+		/* not in the table, fmacInit falls back to the greedy search */
+		const bool greedy = n > tableN;
+		if (!(greedy ? ksetGreedy (k, n) : ksetFind (k, n))) {
+			fprintf (stderr, "no k-set for n=%u\n", n);
+			exit (EXIT_FAILURE);
+		}
+		const uint32_t kmax = ksetMax (k, n);
+		const uint32_t wait = kmax*(n-1)+1;
+		printf ("%3u %5u %8u", n, kmax, wait);
+		if (deltaUs != 0) {
+			printf (" %10.1f", (double) wait*deltaUs/1000.0);
+		}
+		printf (" %8s ", greedy ? "greedy" : "optimal");
+		for (uint8_t j = 0; j < n; j++) {
+			printf (" %u", k[j]);
+		}
+		printf ("\n");
+	}
+}
+
+int main (int argc, char **argv) {
+	unsigned int maxN = 16, deltaUs = 0;
+	bool report = false;
+	int opt;
+
+	while ((opt = getopt (argc, argv, "n:rd:")) != -1) {
+		switch (opt) {
+			case 'n':
+				maxN = atoi (optarg);
+				break;
+
+			case 'r':
+				report = true;
+				break;
+
+			case 'd':
+				deltaUs = atoi (optarg);
+				break;
+
+			default:
+				usage (argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+	if (maxN < 1 || maxN > KSET_MAX_N) {
+		usage (argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	if (report) {
+		writeReport (maxN, deltaUs);
+	} else {
+		writeTable (maxN);
+	}
+
+	return EXIT_SUCCESS;
+}
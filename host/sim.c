@@ -0,0 +1,753 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*	Discrete-event simulator for the f-MAC scheduler. fmac.c, timer.c,
+ *	packet.c and crc32.c run unmodified against simulated CCU4 timers and
+ *	TDA5340 transceivers (simhal.c), one of each per station. Parameter sweeps run in
+ *	parallel, one process per point.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include <SEGGER_RTT.h>
+
+#include "sim.h"
+#include "fmac.h"
+#include "config.h"
+#include "util.h"
+
+typedef struct {
+	unsigned int n, payload;
+	/* smallest payload, lengths are uniformly distributed up to payload */
+	unsigned int minPayload;
+	/* max packets per framelet */
+	unsigned int train;
+	/* PACKET_* encoder */
+	uint8_t encoder;
+	/* send every packet to a random other station instead of broadcasting */
+	bool unicast;
+	/* δ in μs, zero uses the one computed by fmacInit */
+	unsigned int deltaUs;
+	/* packets per second and station, zero saturates */
+	double load;
+	double seconds;
+	/* max clock deviation of each station */
+	double ppm;
+	/* timer interrupt latency is uniform up to this, in μs */
+	double latencyUs;
+	/* host tx queue depth */
+	unsigned int queue;
+	uint64_t seed;
+} simParam;
+
+typedef struct {
+	double deltaUs;
+	/* largest δ calibrated by any station, see fmacGetTiming */
+	double calUs;
+	/* largest clock skew estimated by any station and the largest error of
+	 * these estimates, in ppm */
+	double drift, skewError;
+	uint64_t offered, dropped, sent;
+	uint64_t frames, received, collisions, missed;
+	/* fraction of time the channel is used, summed over all stations */
+	double airtime;
+	/* packets passed to the host, including duplicates */
+	uint64_t rxcalls, delivered, expected;
+	/* framelets dropped by their destination before decoding */
+	uint64_t filtered;
+	/* per station, in packets/s */
+	double throughput;
+	/* latency percentiles in ms */
+	double p50, p90, p99, max;
+	/* host cycles in rxeom, percentiles */
+	double eom50, eom99, eom999;
+	/* deviation of repetitions from their schedule in μs, percentiles */
+	double jitter99, jitterMax;
+	bool done;
+} simResult;
+
+typedef struct {
+	simTime t;
+	/* insertion order, keeps events at the same time in order */
+	uint64_t order;
+	simEventType type;
+	simStation *st;
+	uint32_t generation;
+} simEvent;
+
+static simTime now;
+static uint64_t eventOrder;
+static simEvent *events;
+static size_t eventCount, eventCap;
+
+static simStation *stations;
+static unsigned int stationCount;
+static const simParam *param;
+/* stations boot before startTime, traffic flows until endTime */
+static simTime startTime, endTime;
+static uint64_t rng;
+
+static double *latency;
+static size_t latencyCount, latencyCap;
+static simResult *result;
+
+/* ===== event queue ===== */
+
+static bool before (const simEvent * const a, const simEvent * const b) {
+	return a->t < b->t || (a->t == b->t && a->order < b->order);
+}
+
+static void swap (simEvent * const a, simEvent * const b) {
+	const simEvent t = *a;
+	*a = *b;
+	*b = t;
+}
+
+void simSchedule (const simTime t, const simEventType type,
+		simStation * const st, const uint32_t generation) {
+	assert (t >= now);
+	if (eventCount == eventCap) {
+		eventCap = eventCap == 0 ? 256 : eventCap*2;
+		events = realloc (events, eventCap*sizeof (*events));
+		assert (events != NULL);
+	}
+	size_t i = eventCount++;
+	events[i] = (simEvent) { .t = t, .order = eventOrder++, .type = type,
+			.st = st, .generation = generation };
+	while (i > 0 && before (&events[i], &events[(i-1)/2])) {
+		swap (&events[i], &events[(i-1)/2]);
+		i = (i-1)/2;
+	}
+}
+
+static simEvent pop (void) {
+	assert (eventCount > 0);
+	const simEvent ret = events[0];
+	events[0] = events[--eventCount];
+	size_t i = 0;
+	while (true) {
+		const size_t l = 2*i+1, r = 2*i+2;
+		size_t m = i;
+		if (l < eventCount && before (&events[l], &events[m])) {
+			m = l;
+		}
+		if (r < eventCount && before (&events[r], &events[m])) {
+			m = r;
+		}
+		if (m == i) {
+			break;
+		}
+		swap (&events[i], &events[m]);
+		i = m;
+	}
+	return ret;
+}
+
+simTime simNow (void) {
+	return now;
+}
+
+void simEnter (simStation * const st) {
+	simCcu4 = &st->ccu4;
+	timerActive = &st->timers;
+}
+
+simStation *simStationGet (const unsigned int i) {
+	assert (i < stationCount);
+	return &stations[i];
+}
+
+unsigned int simStationCount (void) {
+	return stationCount;
+}
+
+/* ===== random numbers ===== */
+
+static uint64_t random64 (void) {
+	/* xorshift64* */
+	rng ^= rng >> 12;
+	rng ^= rng << 25;
+	rng ^= rng >> 27;
+	return rng * UINT64_C(2685821657736338717);
+}
+
+/*	Uniform in [0, 1)
+ */
+static double randomUniform (void) {
+	return (double) (random64 () >> 11) * (1.0/9007199254740992.0);
+}
+
+static simTime randomExp (const double rate) {
+	return (simTime) (-log (1.0 - randomUniform ())/rate*SIM_S);
+}
+
+/* ===== traffic ===== */
+
+static bool saturated (void) {
+	return param->load == 0;
+}
+
+/*	MAC wants to send, like spiclientTx
+ */
+static bool simTx (void * const data, const void ** const payload,
+		size_t * const size, uint8_t * const dest) {
+	simStation * const st = data;
+	simTraffic * const tr = &st->traffic;
+
+	if (saturated ()) {
+		if (now < startTime || now >= endTime) {
+			return false;
+		}
+		tr->enqueued[tr->seqIn%SIM_SEQ_RING] = now;
+		++tr->seqIn;
+		++result->offered;
+	}
+	if (tr->seqOut == tr->seqIn) {
+		return false;
+	}
+
+	const uint32_t seq = tr->seqOut++;
+	*dest = FMAC_ADDR_BROADCAST;
+	if (param->unicast) {
+		*dest = random64 ()%(param->n-1);
+		if (*dest >= st->id) {
+			++*dest;
+		}
+	}
+	tr->dest[seq%SIM_SEQ_RING] = *dest;
+	memset (tr->payload, 0, sizeof (tr->payload));
+	tr->payload[0] = st->id;
+	memcpy (&tr->payload[1], &seq, sizeof (seq));
+	*payload = tr->payload;
+	*size = param->payload;
+	if (param->minPayload != 0 && param->minPayload < param->payload) {
+		*size = param->minPayload +
+				random64 ()%(param->payload - param->minPayload + 1);
+	}
+	++result->sent;
+	return true;
+}
+
+/*	Packet received, like spiclientRx
+ */
+static bool simRx (void * const data, const void * const payload,
+		const size_t size) {
+	simStation * const st = data;
+	const uint8_t * const p = payload;
+	assert (size >= 5);
+
+	const uint8_t src = p[0];
+	uint32_t seq;
+	memcpy (&seq, &p[1], sizeof (seq));
+	assert (src < stationCount && src != st->id);
+	const uint8_t dest = stations[src].traffic.dest[seq%SIM_SEQ_RING];
+	assert (dest == FMAC_ADDR_BROADCAST || dest == st->id);
+
+	++result->rxcalls;
+	if ((int32_t) (seq - st->traffic.lastSeq[src]) <= 0) {
+		/* repetition, trains deliver several seqs at once */
+		return true;
+	}
+	st->traffic.lastSeq[src] = seq;
+	++result->delivered;
+
+	const simTime enqueued = stations[src].traffic.enqueued[seq%SIM_SEQ_RING];
+	if (latencyCount == latencyCap) {
+		latencyCap = latencyCap == 0 ? 1024 : latencyCap*2;
+		latency = realloc (latency, latencyCap*sizeof (*latency));
+		assert (latency != NULL);
+	}
+	latency[latencyCount++] = (double) (now - enqueued)/SIM_MS;
+	return true;
+}
+
+/*	Host queued a packet, like WRITEBUF followed by triggerSend. Saturated
+ *	stations just get a kick at startTime.
+ */
+static void arrival (simStation * const st) {
+	simTraffic * const tr = &st->traffic;
+
+	if (now >= endTime) {
+		return;
+	}
+	if (!saturated ()) {
+		++result->offered;
+		if (tr->seqIn - tr->seqOut >= param->queue) {
+			++result->dropped;
+			simSchedule (now + randomExp (param->load), SIM_EV_ARRIVAL, st, 0);
+			return;
+		}
+		tr->enqueued[tr->seqIn%SIM_SEQ_RING] = now;
+		++tr->seqIn;
+		simSchedule (now + randomExp (param->load), SIM_EV_ARRIVAL, st, 0);
+	}
+
+	/* fetched by the main loop */
+	fmacPoll (&st->fm);
+}
+
+static void timerIrq (XMC_CCU4_MODULE_t * const module,
+		XMC_CCU4_SLICE_t * const slice, const XMC_CCU4_SLICE_IRQ_ID_t event) {
+	simStation * const st = module->data;
+	if (param->latencyUs > 0) {
+		simSchedule (now + (simTime) (randomUniform ()*param->latencyUs*SIM_US),
+				SIM_EV_IRQ, st, 0);
+	} else {
+		timerIrqHandle ();
+	}
+}
+
+static void boot (simStation * const st) {
+	timerInit (0);
+	fmacInit (&st->fm, st->id, param->n, &st->tda, param->payload, param->train,
+			param->encoder);
+	if (param->deltaUs != 0) {
+		/* bypasses fmacSetDelta’s floor, to explore too short δ */
+		st->fm.delta = (uint32_t) (param->deltaUs*1000.0/simCcu4TickNs (&st->ccu4.cc[0]));
+		st->fm.deltaNext = st->fm.delta;
+	}
+	result->deltaUs = st->fm.delta*simCcu4TickNs (&st->ccu4.cc[0])/1000.0;
+}
+
+/* ===== simulation ===== */
+
+static int compareDouble (const void * const a, const void * const b) {
+	const double x = *(const double *) a, y = *(const double *) b;
+	return x < y ? -1 : x > y;
+}
+
+static int compareUint32 (const void * const a, const void * const b) {
+	const uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+	return x < y ? -1 : x > y;
+}
+
+static double eomPercentile (const double p) {
+	const simRadioStats * const s = &simRadioStatistics;
+	if (s->eomCount == 0) {
+		return NAN;
+	}
+	size_t i = (size_t) ceil (p*s->eomCount);
+	i = i == 0 ? 0 : i-1;
+	return s->eomCycles[i < s->eomCount ? i : s->eomCount-1];
+}
+
+static double jitterPercentile (const double p) {
+	const simRadioStats * const s = &simRadioStatistics;
+	if (s->jitterCount == 0) {
+		return NAN;
+	}
+	size_t i = (size_t) ceil (p*s->jitterCount);
+	i = i == 0 ? 0 : i-1;
+	return s->jitter[i < s->jitterCount ? i : s->jitterCount-1]/1000.0;
+}
+
+static double percentile (const double p) {
+	if (latencyCount == 0) {
+		return NAN;
+	}
+	size_t i = (size_t) ceil (p*latencyCount);
+	i = i == 0 ? 0 : i-1;
+	return latency[i < latencyCount ? i : latencyCount-1];
+}
+
+static void run (const simParam * const p, simResult * const res) {
+	param = p;
+	result = res;
+	memset (res, 0, sizeof (*res));
+	now = 0;
+	eventCount = 0;
+	eventOrder = 0;
+	latencyCount = 0;
+	rng = p->seed == 0 ? 1 : p->seed;
+	startTime = 100*SIM_MS;
+	endTime = startTime + (simTime) (p->seconds*SIM_S);
+	simChannelReset ();
+
+	stationCount = p->n;
+	stations = calloc (stationCount, sizeof (*stations));
+	assert (stations != NULL);
+	for (unsigned int i = 0; i < stationCount; i++) {
+		simStation * const st = &stations[i];
+		st->id = i;
+		st->traffic.lastSeq = malloc (stationCount*sizeof (*st->traffic.lastSeq));
+		assert (st->traffic.lastSeq != NULL);
+		memset (st->traffic.lastSeq, 0xff, stationCount*sizeof (*st->traffic.lastSeq));
+		st->ppm = (2.0*randomUniform ()-1.0)*p->ppm;
+		simCcu4Init (&st->ccu4, st->ppm, timerIrq, st);
+		simRadioInit (&st->radio, i, &st->tda);
+		st->fm.cbdata = st;
+		st->fm.txcb = simTx;
+		st->fm.rxcb = simRx;
+
+		/* stations are not synchronized */
+		simSchedule ((simTime) (randomUniform ()*startTime), SIM_EV_BOOT, st, 0);
+		simSchedule (startTime + (saturated () ? 0 : randomExp (p->load)),
+				SIM_EV_ARRIVAL, st, 0);
+	}
+
+	/* let the last sequences finish */
+	simTime drain = 0;
+	while (eventCount > 0) {
+		const simEvent ev = pop ();
+		if (drain == 0 && ev.t >= endTime) {
+			const fmacCtx * const fm = &stations[0].fm;
+			drain = endTime + (simTime) (2.0*(fm->kmax*(fm->n-1)+1)*fm->delta*
+					simCcu4TickNs (&stations[0].ccu4.cc[0]));
+		}
+		/* idle timers fire far in the future */
+		if (drain != 0 && ev.t > drain) {
+			now = drain;
+			break;
+		}
+		now = ev.t;
+
+		simEnter (ev.st);
+		switch (ev.type) {
+			case SIM_EV_TIMER:
+				simCcu4Event (&ev.st->ccu4, ev.generation);
+				break;
+
+			case SIM_EV_TXREADY:
+			case SIM_EV_TXEND:
+				simRadioEvent (ev.st, ev.type, ev.generation);
+				break;
+
+			case SIM_EV_ARRIVAL:
+				arrival (ev.st);
+				break;
+
+			case SIM_EV_BOOT:
+				boot (ev.st);
+				break;
+
+			case SIM_EV_IRQ:
+				timerIrqHandle ();
+				break;
+		}
+		/* main loops, interrupts of one station (rxeom) may be caused by
+		 * another one’s event */
+		for (unsigned int i = 0; i < stationCount; i++) {
+			simEnter (&stations[i]);
+			fmacProcess (&stations[i].fm);
+		}
+	}
+
+	res->frames = simRadioStatistics.frames;
+	res->received = simRadioStatistics.received;
+	res->collisions = simRadioStatistics.collisions;
+	res->missed = simRadioStatistics.missed;
+	res->airtime = (double) simRadioStatistics.airtime/now;
+	/* receivers per packet */
+	const unsigned int receivers = p->unicast ? 1 : p->n-1;
+	res->expected = res->sent*receivers;
+	res->throughput = (double) res->delivered/receivers/p->n/p->seconds;
+	for (unsigned int i = 0; i < stationCount; i++) {
+		res->filtered += stations[i].fm.filtered;
+		fmacTiming t;
+		fmacGetTiming (&stations[i].fm, &t);
+		if (t.calibrated > res->calUs) {
+			res->calUs = t.calibrated;
+		}
+		if (t.drift > res->drift) {
+			res->drift = t.drift;
+		}
+		for (unsigned int j = 0; j < stationCount; j++) {
+			int32_t ppm;
+			if (fmacGetSkew (&stations[i].fm, j, &ppm)) {
+				/* j’s ticks as counted by i */
+				const double actual = ((1.0+stations[j].ppm*1e-6)/
+						(1.0+stations[i].ppm*1e-6)-1.0)*1e6;
+				const double error = fabs (ppm - actual);
+				if (error > res->skewError) {
+					res->skewError = error;
+				}
+			}
+		}
+	}
+	qsort (latency, latencyCount, sizeof (*latency), compareDouble);
+	res->p50 = percentile (0.5);
+	res->p90 = percentile (0.9);
+	res->p99 = percentile (0.99);
+	res->max = percentile (1.0);
+	qsort (simRadioStatistics.eomCycles, simRadioStatistics.eomCount,
+			sizeof (*simRadioStatistics.eomCycles), compareUint32);
+	res->eom50 = eomPercentile (0.5);
+	res->eom99 = eomPercentile (0.99);
+	res->eom999 = eomPercentile (0.999);
+	qsort (simRadioStatistics.jitter, simRadioStatistics.jitterCount,
+			sizeof (*simRadioStatistics.jitter), compareUint32);
+	res->jitter99 = jitterPercentile (0.99);
+	res->jitterMax = jitterPercentile (1.0);
+	res->done = true;
+
+	for (unsigned int i = 0; i < stationCount; i++) {
+		free (stations[i].traffic.lastSeq);
+	}
+	free (stations);
+	stations = NULL;
+}
+
+/* ===== sweeps ===== */
+
+#define MAX_LIST (32)
+
+typedef struct {
+	double v[MAX_LIST];
+	unsigned int count;
+} simList;
+
+static bool parseList (simList * const l, const char * const s) {
+	char *end;
+	const char *cur = s;
+	l->count = 0;
+	while (l->count < MAX_LIST) {
+		l->v[l->count++] = strtod (cur, &end);
+		if (end == cur) {
+			return false;
+		}
+		if (*end == '\0') {
+			return true;
+		}
+		if (*end != ',') {
+			return false;
+		}
+		cur = end+1;
+	}
+	return false;
+}
+
+static void printHeader (void) {
+	printf ("%3s %4s %3s %8s %8s %6s %6s %7s %8s %7s %8s %8s %7s %7s %6s %7s %6s %7s %9s %8s %8s %8s %8s %7s %7s %7s %6s %6s\n",
+			"n", "pl", "T", "δ/μs", "δcal/μs", "drift", "skewerr", "load", "offered", "dropped", "sent",
+			"frames", "collis", "missed", "air%", "deliv%", "dup", "filt", "pkt/s/sta", "p50/ms",
+			"p90/ms", "p99/ms", "max/ms", "eom50", "eom99", "eom999", "jit99", "jitmax");
+}
+
+static void printResult (const simParam * const p, const simResult * const r) {
+	if (!r->done) {
+		printf ("%3u %4u %3u failed\n", p->n, p->payload, p->train);
+		return;
+	}
+	printf ("%3u %4u %3u %8.0f %8.0f %6.0f %6.1f %7.2f %8lu %7lu %8lu %8lu %7lu %7lu %6.2f %7.2f %6lu %7lu %9.3f %8.1f %8.1f %8.1f %8.1f %7.0f %7.0f %7.0f %6.1f %6.1f\n",
+			p->n, p->payload, p->train, r->deltaUs, r->calUs, r->drift, r->skewError, p->load, r->offered, r->dropped,
+			r->sent, r->frames, r->collisions, r->missed, 100.0*r->airtime,
+			r->expected == 0 ? 0.0 : 100.0*r->delivered/r->expected,
+			r->rxcalls - r->delivered, r->filtered,
+			r->throughput, r->p50, r->p90, r->p99, r->max, r->eom50, r->eom99,
+			r->eom999, r->jitter99, r->jitterMax);
+}
+
+static const char * const encoderNames[PACKET_ENCODER_COUNT] = {
+	[PACKET_8B10B] = "8b10b",
+	[PACKET_RS] = "rs",
+	[PACKET_SCRAMBLED] = "scrambled",
+	[PACKET_IDENTITY] = "identity",
+	};
+
+static bool parseEncoder (uint8_t * const encoder, const char * const name) {
+	for (uint8_t i = 0; i < PACKET_ENCODER_COUNT; i++) {
+		if (strcmp (name, encoderNames[i]) == 0) {
+			*encoder = i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static void usage (const char * const name) {
+	fprintf (stderr, "Usage: %s [-n stations] [-p payload] [-d delta_us] "
+			"[-m min_payload] [-l load] [-T train] [-e encoder] [-t seconds] [-D ppm] [-L latency_us] [-q queue] [-s seed] [-j jobs] [-C] [-U] [-v]\n"
+			"n, p, d, l and T accept comma-separated lists, every combination is "
+			"simulated.\nLoad is in packets/s per station, 0 saturates. Payload "
+			"lengths are uniform\nbetween min_payload and payload. -C receives collided "
+			"framelets with errors\ninstead of dropping them. Encoders are 8b10b, rs, "
+			"scrambled and identity.\n-U sends each packet to one random station "
+			"instead of all.\n-L delays timer interrupts by up to latency_us, "
+			"jitmax shows how far repetitions\nstray from their schedule.\n", name);
+}
+
+int main (int argc, char **argv) {
+	simList n = { .v = {3}, .count = 1 }, payload = { .v = {16}, .count = 1 },
+			delta = { .v = {0}, .count = 1 }, load = { .v = {0}, .count = 1 },
+			train = { .v = {1}, .count = 1 };
+	simParam base = { .seconds = 60, .queue = 2, .seed = 1,
+			.encoder = PACKET_ENCODER };
+	long jobs = sysconf (_SC_NPROCESSORS_ONLN);
+	int opt;
+
+	while ((opt = getopt (argc, argv, "n:p:m:d:l:T:e:t:D:L:q:s:j:vCU")) != -1) {
+		bool ok = true;
+		switch (opt) {
+			case 'n':
+				ok = parseList (&n, optarg);
+				break;
+
+			case 'p':
+				ok = parseList (&payload, optarg);
+				break;
+
+			case 'm':
+				base.minPayload = atoi (optarg);
+				break;
+
+			case 'd':
+				ok = parseList (&delta, optarg);
+				break;
+
+			case 'l':
+				ok = parseList (&load, optarg);
+				break;
+
+			case 'T':
+				ok = parseList (&train, optarg);
+				break;
+
+			case 'e':
+				ok = parseEncoder (&base.encoder, optarg);
+				break;
+
+			case 't':
+				base.seconds = atof (optarg);
+				break;
+
+			case 'D':
+				base.ppm = atof (optarg);
+				break;
+
+			case 'L':
+				base.latencyUs = atof (optarg);
+				break;
+
+			case 'q':
+				base.queue = atoi (optarg);
+				break;
+
+			case 's':
+				base.seed = strtoull (optarg, NULL, 0);
+				break;
+
+			case 'j':
+				jobs = atol (optarg);
+				break;
+
+			case 'v':
+				simVerbose = true;
+				break;
+
+			case 'C':
+				simRadioParams.garble = true;
+				break;
+
+			case 'U':
+				base.unicast = true;
+				break;
+
+			default:
+				ok = false;
+				break;
+		}
+		if (!ok) {
+			usage (argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (jobs < 1) {
+		jobs = 1;
+	}
+
+	const size_t points = n.count*payload.count*delta.count*load.count*
+			train.count;
+	simParam * const params = calloc (points, sizeof (*params));
+	assert (params != NULL);
+	size_t i = 0;
+	for (unsigned int a = 0; a < n.count; a++) {
+		for (unsigned int b = 0; b < payload.count; b++) {
+			for (unsigned int c = 0; c < delta.count; c++) {
+				for (unsigned int d = 0; d < load.count; d++) {
+					for (unsigned int e = 0; e < train.count; e++) {
+						simParam * const p = &params[i];
+						*p = base;
+						p->n = n.v[a];
+						p->payload = payload.v[b];
+						p->deltaUs = delta.v[c];
+						p->load = load.v[d];
+						p->train = train.v[e];
+						p->seed = base.seed + i*UINT64_C(0x9e3779b97f4a7c15);
+						const unsigned int body = FMAC_HEADER_LEN + (p->train > 1 ?
+								1+p->train*(2+p->payload) : p->payload);
+						if (p->n < 2 || p->n > KSET_MAX_N || p->payload < 5 ||
+								p->payload > FMAC_MAX_PAYLOAD_LEN || p->load < 0 ||
+								body > FMAC_MAX_BODY_LEN) {
+							fprintf (stderr, "invalid parameters: n=%u, payload=%u, "
+									"train=%u\n", p->n, p->payload, p->train);
+							return EXIT_FAILURE;
+						}
+						++i;
+					}
+				}
+			}
+		}
+	}
+
+	/* shared with the worker processes */
+	simResult * const results = mmap (NULL, points*sizeof (*results),
+			PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	assert (results != MAP_FAILED);
+	memset (results, 0, points*sizeof (*results));
+
+	if (points == 1 || jobs == 1) {
+		for (i = 0; i < points; i++) {
+			run (&params[i], &results[i]);
+		}
+	} else {
+		long running = 0;
+		for (i = 0; i < points || running > 0; ) {
+			if (i < points && running < jobs) {
+				const pid_t pid = fork ();
+				assert (pid >= 0);
+				if (pid == 0) {
+					run (&params[i], &results[i]);
+					_exit (EXIT_SUCCESS);
+				}
+				++running;
+				++i;
+			} else {
+				wait (NULL);
+				--running;
+			}
+		}
+	}
+
+	printHeader ();
+	for (i = 0; i < points; i++) {
+		printResult (&params[i], &results[i]);
+	}
+
+	return EXIT_SUCCESS;
+}
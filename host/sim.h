@@ -0,0 +1,145 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <xmc_ccu4.h>
+#include <tda5340.h>
+
+#include "fmac.h"
+#include "timer.h"
+
+/* simulation time in ns */
+typedef int64_t simTime;
+
+#define SIM_US (1000)
+#define SIM_MS (1000*SIM_US)
+#define SIM_S (1000*SIM_MS)
+
+typedef enum {
+	SIM_EV_TIMER,
+	SIM_EV_TXREADY,
+	SIM_EV_TXEND,
+	SIM_EV_ARRIVAL,
+	SIM_EV_BOOT,
+	/* timer interrupt handler, after latency */
+	SIM_EV_IRQ,
+} simEventType;
+
+/* a framelet on air */
+typedef struct {
+	unsigned int station;
+	simTime start, end;
+	uint8_t data[FMAC_MAX_PACKET_LEN];
+	size_t bits;
+} simFrame;
+
+typedef struct {
+	unsigned int station;
+	tda5340Ctx *tda;
+	/* transmission in progress, if any */
+	simFrame *tx;
+	/* receiver listens from this time on, until mode changes */
+	bool rxOn;
+	simTime rxSince;
+	/* fifo contents of last received frame */
+	uint8_t rxData[FMAC_MAX_PACKET_LEN];
+	size_t rxBits, rxRead;
+	uint32_t generation;
+	/* first tx request of the current sequence */
+	simTime seqStart;
+} simRadio;
+
+/* enqueue times kept per station, must exceed packets in flight */
+#define SIM_SEQ_RING (4096)
+
+typedef struct {
+	/* sequence numbers of the next packet queued and sent, everything in
+	 * between waits like in spiclient’s tx fifo */
+	uint32_t seqIn, seqOut;
+	simTime enqueued[SIM_SEQ_RING];
+	/* destination of each packet sent */
+	uint8_t dest[SIM_SEQ_RING];
+	/* last sequence number received, by source station */
+	uint32_t *lastSeq;
+	uint8_t payload[FMAC_MAX_PACKET_LEN];
+} simTraffic;
+
+typedef struct {
+	unsigned int id;
+	fmacCtx fm;
+	tda5340Ctx tda;
+	XMC_CCU4_MODULE_t ccu4;
+	/* pending timers, see timerActive */
+	timerQueue timers;
+	/* clock deviation of ccu4 */
+	double ppm;
+	simRadio radio;
+	simTraffic traffic;
+} simStation;
+
+/* radio parameters, see simhal.c */
+typedef struct {
+	/* mode switching time, rx→tx and tx→rx */
+	simTime rxtx, txrx;
+	/* runin and tsi, not part of the data read from the fifo */
+	unsigned int preambleBits;
+	/* hand collided frames to the receiver with errors instead of dropping
+	 * them */
+	bool garble;
+} simRadioParam;
+
+typedef struct {
+	uint64_t frames, received, collisions, missed;
+	/* sum of all frames’ time on air */
+	simTime airtime;
+	/* host cycles spent in each rxeom call, while the timer interrupt would
+	 * be blocked */
+	uint32_t *eomCycles;
+	size_t eomCount, eomCap;
+	/* deviation of each repetition’s tx request from its schedule, in ns */
+	uint32_t *jitter;
+	size_t jitterCount, jitterCap;
+} simRadioStats;
+
+extern simRadioParam simRadioParams;
+extern simRadioStats simRadioStatistics;
+
+simTime simNow (void);
+void simSchedule (const simTime t, const simEventType type,
+		simStation * const st, const uint32_t generation);
+void simEnter (simStation * const st);
+simStation *simStationGet (const unsigned int i);
+unsigned int simStationCount (void);
+
+void simCcu4Init (XMC_CCU4_MODULE_t * const module, const double ppm,
+		simCcu4Irq irq, void * const data);
+void simCcu4Event (XMC_CCU4_MODULE_t * const module, const uint32_t generation);
+double simCcu4TickNs (const XMC_CCU4_SLICE_t * const s);
+void simChannelReset (void);
+void simRadioInit (simRadio * const radio, const unsigned int station,
+		tda5340Ctx * const tda);
+void simRadioEvent (simStation * const st, const simEventType type,
+		const uint32_t generation);
@@ -0,0 +1,621 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*	Simulated hardware: CCU4 compare timer, TDA5340 transceiver and the
+ *	shared radio channel
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <xmc_ccu4.h>
+#include <xmc_gpio.h>
+#include <tda5340.h>
+#include <SEGGER_RTT.h>
+
+#include "sim.h"
+#include "util.h"
+
+/* ===== ccu4 ===== */
+
+/* fccu of the xmc4500 relax kit, see SystemCoreClockSetup */
+#define CCU_FREQ (80000000)
+
+XMC_CCU4_MODULE_t *simCcu4;
+
+void simCcu4Init (XMC_CCU4_MODULE_t * const module, const double ppm,
+		simCcu4Irq irq, void * const data) {
+	memset (module, 0, sizeof (*module));
+	for (uint8_t i = 0; i < arraysize (module->cc); i++) {
+		module->cc[i].module = module;
+		module->cc[i].no = i;
+	}
+	/* a fast clock has shorter ticks */
+	module->clockNs = 1e9/CCU_FREQ/(1.0+ppm*1e-6);
+	module->irq = irq;
+	module->data = data;
+}
+
+static double tickNs (const XMC_CCU4_SLICE_t * const s) {
+	return s->module->clockNs * (double) (1U << s->prescaler);
+}
+
+/*	Tick length of slice in ns
+ */
+double simCcu4TickNs (const XMC_CCU4_SLICE_t * const s) {
+	return tickNs (s);
+}
+
+static void transfer (XMC_CCU4_SLICE_t * const s) {
+	s->compare = s->compareShadow;
+	s->period = s->periodShadow;
+	s->transferPending = false;
+}
+
+static bool concatenatedLower (const XMC_CCU4_SLICE_t * const s) {
+	return s->no < 3 && s->module->cc[s->no+1].concatenated;
+}
+
+/*	Bring all timers up to date. Concatenated slices count period matches of
+ *	the previous slice.
+ */
+static void sync (XMC_CCU4_MODULE_t * const m) {
+	const double now = simNow ();
+	uint64_t carry = 0;
+
+	for (uint8_t i = 0; i < arraysize (m->cc); i++) {
+		XMC_CCU4_SLICE_t * const s = &m->cc[i];
+		s->wrapped = false;
+		if (!s->running) {
+			carry = 0;
+			continue;
+		}
+
+		uint64_t ticks;
+		if (s->concatenated) {
+			ticks = carry;
+		} else {
+			const double t = tickNs (s);
+			ticks = now > s->ref ? (uint64_t) floor ((now - s->ref)/t) : 0;
+			s->ref += (double) ticks*t;
+		}
+		const uint64_t len = (uint64_t) s->period + 1;
+		const uint64_t total = s->timer + ticks;
+		carry = total/len;
+		s->timer = total%len;
+		if (carry > 0) {
+			s->wrapped = true;
+			if (s->transferPending) {
+				transfer (s);
+			}
+			if (s->monoshot == XMC_CCU4_SLICE_TIMER_REPEAT_MODE_SINGLE &&
+					!s->concatenated && !concatenatedLower (s)) {
+				s->running = false;
+				s->timer = 0;
+			}
+		}
+	}
+}
+
+static void candidate (double * const best, const double t) {
+	if (t < *best) {
+		*best = t;
+	}
+}
+
+/*	Schedule the next compare match, period match or pending shadow transfer
+ */
+static void reschedule (XMC_CCU4_MODULE_t * const m) {
+	double best = INFINITY;
+
+	for (uint8_t i = 0; i < arraysize (m->cc); i++) {
+		const XMC_CCU4_SLICE_t * const s = &m->cc[i];
+		if (!s->running || s->concatenated) {
+			continue;
+		}
+		const double t = tickNs (s);
+		const uint64_t len = (uint64_t) s->period + 1;
+		const uint64_t wrap = len - s->timer;
+
+		if (concatenatedLower (s) && m->cc[i+1].running) {
+			/* 32 bit timer */
+			const XMC_CCU4_SLICE_t * const u = &m->cc[i+1];
+			assert (s->period == 0xffff && u->period == 0xffff);
+			const uint32_t value = ((uint32_t) u->timer << 16) | s->timer;
+			const uint32_t target = ((uint32_t) u->compare << 16) | s->compare;
+			if (u->events & (1U << XMC_CCU4_SLICE_IRQ_ID_COMPARE_MATCH_UP)) {
+				uint64_t d = (uint32_t) (target - value);
+				if (d == 0) {
+					d = UINT64_C(1) << 32;
+				}
+				candidate (&best, s->ref + (double) d*t);
+			}
+			if (s->transferPending) {
+				candidate (&best, s->ref + (double) wrap*t);
+			}
+			if (u->transferPending) {
+				const uint64_t d = (UINT64_C(1) << 32) - value;
+				candidate (&best, s->ref + (double) d*t);
+			}
+		} else {
+			if (s->events & (1U << XMC_CCU4_SLICE_IRQ_ID_COMPARE_MATCH_UP) &&
+					s->compare <= s->period) {
+				uint64_t d = (s->compare + len - s->timer) % len;
+				if (d == 0) {
+					d = len;
+				}
+				candidate (&best, s->ref + (double) d*t);
+			}
+			if (s->events & (1U << XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH) ||
+					s->transferPending ||
+					s->monoshot == XMC_CCU4_SLICE_TIMER_REPEAT_MODE_SINGLE) {
+				candidate (&best, s->ref + (double) wrap*t);
+			}
+		}
+	}
+
+	++m->generation;
+	if (best != INFINITY) {
+		simSchedule ((simTime) ceil (best), SIM_EV_TIMER, m->data, m->generation);
+	}
+}
+
+/*	Scheduled timer event, fire interrupts
+ */
+void simCcu4Event (XMC_CCU4_MODULE_t * const m, const uint32_t generation) {
+	if (generation != m->generation) {
+		/* stale */
+		return;
+	}
+
+	sync (m);
+	for (uint8_t i = 0; i < arraysize (m->cc); i++) {
+		XMC_CCU4_SLICE_t * const s = &m->cc[i];
+		bool compare;
+		if (s->concatenated) {
+			const XMC_CCU4_SLICE_t * const l = &m->cc[i-1];
+			compare = s->timer == s->compare && l->timer == l->compare &&
+					s->running && l->running;
+		} else if (concatenatedLower (s)) {
+			continue;
+		} else {
+			compare = s->timer == s->compare && s->running;
+		}
+		if (compare && s->events & (1U << XMC_CCU4_SLICE_IRQ_ID_COMPARE_MATCH_UP)) {
+			m->irq (m, s, XMC_CCU4_SLICE_IRQ_ID_COMPARE_MATCH_UP);
+		}
+		if (s->wrapped && s->events & (1U << XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH)) {
+			m->irq (m, s, XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+		}
+	}
+	reschedule (m);
+}
+
+void XMC_CCU4_SetModuleClock (XMC_CCU4_MODULE_t * const module,
+		const XMC_CCU4_CLOCK_t clock) {
+}
+
+void XMC_CCU4_Init (XMC_CCU4_MODULE_t * const module,
+		const XMC_CCU4_SLICE_MCMS_ACTION_t action) {
+}
+
+void XMC_CCU4_StartPrescaler (XMC_CCU4_MODULE_t * const module) {
+}
+
+void XMC_CCU4_EnableClock (XMC_CCU4_MODULE_t * const module, const uint8_t slice) {
+}
+
+/*	Shadow values are transferred immediately if the slice is stopped,
+ *	otherwise on the next period match
+ */
+void XMC_CCU4_EnableShadowTransfer (XMC_CCU4_MODULE_t * const module,
+		const uint32_t mask) {
+	sync (module);
+	for (uint8_t i = 0; i < arraysize (module->cc); i++) {
+		XMC_CCU4_SLICE_t * const s = &module->cc[i];
+		if (mask & (1U << (4*i))) {
+			if (s->running) {
+				s->transferPending = true;
+			} else {
+				transfer (s);
+			}
+		}
+	}
+	reschedule (module);
+}
+
+void XMC_CCU4_SLICE_CompareInit (XMC_CCU4_SLICE_t * const slice,
+		const XMC_CCU4_SLICE_COMPARE_CONFIG_t * const config) {
+	assert (!slice->running);
+	slice->monoshot = config->monoshot;
+	slice->prescaler = config->prescaler_initval;
+	slice->concatenated = config->timer_concatenation;
+}
+
+void XMC_CCU4_SLICE_StartTimer (XMC_CCU4_SLICE_t * const slice) {
+	sync (slice->module);
+	if (!slice->running) {
+		slice->running = true;
+		slice->ref = simNow ();
+	}
+	reschedule (slice->module);
+}
+
+void XMC_CCU4_SLICE_StopTimer (XMC_CCU4_SLICE_t * const slice) {
+	sync (slice->module);
+	slice->running = false;
+	reschedule (slice->module);
+}
+
+void XMC_CCU4_SLICE_ClearTimer (XMC_CCU4_SLICE_t * const slice) {
+	sync (slice->module);
+	slice->timer = 0;
+	slice->ref = simNow ();
+	reschedule (slice->module);
+}
+
+bool XMC_CCU4_SLICE_IsTimerRunning (XMC_CCU4_SLICE_t * const slice) {
+	return slice->running;
+}
+
+uint16_t XMC_CCU4_SLICE_GetTimerValue (XMC_CCU4_SLICE_t * const slice) {
+	sync (slice->module);
+	reschedule (slice->module);
+	return slice->timer;
+}
+
+void XMC_CCU4_SLICE_SetTimerCompareMatch (XMC_CCU4_SLICE_t * const slice,
+		const uint16_t value) {
+	slice->compareShadow = value;
+}
+
+void XMC_CCU4_SLICE_SetTimerPeriodMatch (XMC_CCU4_SLICE_t * const slice,
+		const uint16_t value) {
+	slice->periodShadow = value;
+}
+
+void XMC_CCU4_SLICE_EnableEvent (XMC_CCU4_SLICE_t * const slice,
+		const XMC_CCU4_SLICE_IRQ_ID_t event) {
+	sync (slice->module);
+	slice->events |= 1U << event;
+	reschedule (slice->module);
+}
+
+void XMC_CCU4_SLICE_DisableEvent (XMC_CCU4_SLICE_t * const slice,
+		const XMC_CCU4_SLICE_IRQ_ID_t event) {
+	sync (slice->module);
+	slice->events &= ~(1U << event);
+	reschedule (slice->module);
+}
+
+void XMC_CCU4_SLICE_ClearEvent (XMC_CCU4_SLICE_t * const slice,
+		const XMC_CCU4_SLICE_IRQ_ID_t event) {
+}
+
+void XMC_CCU4_SLICE_SetInterruptNode (XMC_CCU4_SLICE_t * const slice,
+		const XMC_CCU4_SLICE_IRQ_ID_t event, const XMC_CCU4_SLICE_SR_ID_t sr) {
+}
+
+/* ===== tda5340 and channel ===== */
+
+simRadioParam simRadioParams = {
+	.rxtx = 250*SIM_US,
+	.txrx = 250*SIM_US,
+	/* 8 bit runin, 16 bit tsi, see packet.c */
+	.preambleBits = 24,
+	};
+simRadioStats simRadioStatistics;
+
+/* frames on air or recently sent, more than enough for overlap checks */
+static simFrame channel[256];
+static unsigned int channelNext = 0;
+
+void simRadioInit (simRadio * const radio, const unsigned int station,
+		tda5340Ctx * const tda) {
+	memset (radio, 0, sizeof (*radio));
+	radio->station = station;
+	radio->tda = tda;
+	tda->sim = radio;
+	tda->mode = TDA_SLEEP_MODE;
+}
+
+void simChannelReset (void) {
+	memset (channel, 0, sizeof (channel));
+	channelNext = 0;
+	free (simRadioStatistics.eomCycles);
+	free (simRadioStatistics.jitter);
+	memset (&simRadioStatistics, 0, sizeof (simRadioStatistics));
+}
+
+/*	Host timestamp counter, otherwise ns
+ */
+static uint64_t cycles (void) {
+#if defined(__x86_64__) || defined(__i386__)
+	return __rdtsc ();
+#else
+	struct timespec ts;
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+	return (uint64_t) ts.tv_sec*1000000000 + ts.tv_nsec;
+#endif
+}
+
+static void recordEom (const uint64_t c) {
+	simRadioStats * const s = &simRadioStatistics;
+	if (s->eomCount == s->eomCap) {
+		s->eomCap = s->eomCap == 0 ? 1024 : s->eomCap*2;
+		s->eomCycles = realloc (s->eomCycles, s->eomCap*sizeof (*s->eomCycles));
+		assert (s->eomCycles != NULL);
+	}
+	s->eomCycles[s->eomCount++] = c > UINT32_MAX ? UINT32_MAX : c;
+}
+
+/*	Compare the tx request of a repetition to the first one of its sequence
+ *	plus whole k_i·δ of the sender’s clock
+ */
+static void recordJitter (simStation * const st) {
+	const fmacCtx * const fm = &st->fm;
+	simRadio * const r = &st->radio;
+	if (fm->repetition <= 1) {
+		r->seqStart = simNow ();
+		return;
+	}
+	const double ideal = (double) r->seqStart + (double) (fm->repetition-1)*
+			fm->k[fm->i]*fm->delta*simCcu4TickNs (&st->ccu4.cc[0]);
+	const double d = fabs ((double) simNow () - ideal);
+
+	simRadioStats * const s = &simRadioStatistics;
+	if (s->jitterCount == s->jitterCap) {
+		s->jitterCap = s->jitterCap == 0 ? 1024 : s->jitterCap*2;
+		s->jitter = realloc (s->jitter, s->jitterCap*sizeof (*s->jitter));
+		assert (s->jitter != NULL);
+	}
+	s->jitter[s->jitterCount++] = d > UINT32_MAX ? UINT32_MAX : (uint32_t) d;
+}
+
+/*	Duration of one bit in ns
+ */
+static simTime bitTime (const tda5340Ctx * const tda) {
+	const uint32_t kbps = tda->reg[TDA_A_TXBAUDRATE];
+	assert (kbps > 0);
+	return SIM_MS/kbps;
+}
+
+/*	First frame on air at the same time as f, if any
+ */
+static const simFrame *overlapping (const simFrame * const f) {
+	for (unsigned int i = 0; i < arraysize (channel); i++) {
+		const simFrame * const g = &channel[i];
+		if (g != f && g->bits > 0 && g->start < f->end && g->end > f->start) {
+			return g;
+		}
+	}
+	return NULL;
+}
+
+/*	Frame f ended, hand it to every station that could receive it
+ */
+static void deliver (const simFrame * const f) {
+	const simFrame * const other = overlapping (f);
+
+	for (unsigned int i = 0; i < simStationCount (); i++) {
+		if (i == f->station) {
+			continue;
+		}
+		simStation * const st = simStationGet (i);
+		simRadio * const r = &st->radio;
+		if (!r->rxOn || r->rxSince > f->start) {
+			/* transmitting or switching */
+			++simRadioStatistics.missed;
+			continue;
+		}
+		if (other != NULL) {
+			++simRadioStatistics.collisions;
+			if (!simRadioParams.garble) {
+				continue;
+			}
+		} else {
+			++simRadioStatistics.received;
+		}
+
+		/* the tda strips runin and tsi and stops after EOMDLEN bits */
+		const unsigned int preamble = simRadioParams.preambleBits;
+		assert (preamble%8 == 0 && f->bits > preamble);
+		size_t bits = f->bits - preamble;
+		const uint32_t eomdlen = st->tda.reg[TDA_B_EOMDLEN];
+		if (eomdlen != 0 && eomdlen < bits) {
+			bits = eomdlen;
+		}
+		memcpy (r->rxData, &f->data[preamble/8], (bits+7)/8);
+		if (other != NULL) {
+			/* the receiver locks onto f, the other frame adds errors */
+			for (size_t j = 0; j < (bits+7)/8 && preamble/8+j < sizeof (other->data); j++) {
+				r->rxData[j] ^= other->data[preamble/8+j];
+			}
+		}
+		r->rxBits = bits;
+		r->rxRead = 0;
+
+		simEnter (st);
+		if (st->tda.rxeom != NULL) {
+			const uint64_t start = cycles ();
+			st->tda.rxeom (&st->tda, st->tda.data);
+			recordEom (cycles () - start);
+		}
+	}
+}
+
+void simRadioEvent (simStation * const st, const simEventType type,
+		const uint32_t generation) {
+	simRadio * const r = &st->radio;
+	tda5340Ctx * const tda = r->tda;
+
+	switch (type) {
+		case SIM_EV_TXREADY:
+			if (generation != r->generation) {
+				/* mode changed in between */
+				return;
+			}
+			simEnter (st);
+			if (tda->txready != NULL) {
+				tda->txready (tda, tda->data);
+			}
+			break;
+
+		case SIM_EV_TXEND: {
+			simFrame * const f = r->tx;
+			assert (f != NULL);
+			r->tx = NULL;
+			deliver (f);
+			simEnter (st);
+			if (tda->txempty != NULL) {
+				tda->txempty (tda, tda->data);
+			}
+			break;
+		}
+
+		default:
+			assert (0);
+			break;
+	}
+}
+
+bool tda5340ModeSet (tda5340Ctx * const tda, const tda5340Mode mode,
+		const bool selfPolling, const tda5340Config config) {
+	simRadio * const r = tda->sim;
+	simStation * const st = simStationGet (r->station);
+
+	tda->mode = mode;
+	++r->generation;
+	r->rxOn = false;
+	switch (mode) {
+		case TDA_TRANSMIT_MODE:
+			recordJitter (st);
+			simSchedule (simNow () + simRadioParams.rxtx, SIM_EV_TXREADY, st,
+					r->generation);
+			break;
+
+		case TDA_RUN_MODE_SLAVE:
+			r->rxOn = true;
+			r->rxSince = simNow () + simRadioParams.txrx;
+			break;
+
+		default:
+			break;
+	}
+	return true;
+}
+
+bool tda5340RegWrite (tda5340Ctx * const tda, const uint8_t reg,
+		const uint32_t val) {
+	assert (reg < TDA_REG_COUNT);
+	tda->reg[reg] = val;
+	return true;
+}
+
+bool tda5340RegWriteBulk (tda5340Ctx * const tda,
+		const tdaConfigVal * const config, const size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		tda5340RegWrite (tda, config[i].reg, config[i].val);
+	}
+	return true;
+}
+
+/*	Start sending, the frame is on air until the fifo runs empty
+ */
+void tda5340FifoWrite (tda5340Ctx * const tda, const void * const data,
+		const size_t bits) {
+	simRadio * const r = tda->sim;
+	assert (tda->mode == TDA_TRANSMIT_MODE);
+	assert (r->tx == NULL);
+	assert (bits <= sizeof (r->tx->data)*8);
+
+	simFrame * const f = &channel[channelNext];
+	channelNext = (channelNext+1)%arraysize (channel);
+	/* must not be on air any more */
+	assert (f->bits == 0 || f->end < simNow ());
+	f->station = r->station;
+	f->start = simNow ();
+	f->end = f->start + (simTime) bits*bitTime (tda);
+	f->bits = bits;
+	memcpy (f->data, data, (bits+7)/8);
+	r->tx = f;
+	++simRadioStatistics.frames;
+	simRadioStatistics.airtime += f->end - f->start;
+
+	simSchedule (f->end, SIM_EV_TXEND, simStationGet (r->station), 0);
+}
+
+/*	Return received bits in 32 bit blocks, like the chip’s fifo. bits is zero
+ *	at the end of the message.
+ */
+bool tda5340FifoRead (tda5340Ctx * const tda, uint32_t * const block,
+		uint8_t * const bits) {
+	simRadio * const r = tda->sim;
+	const size_t remaining = r->rxBits - r->rxRead;
+	const size_t n = remaining < 32 ? remaining : 32;
+
+	uint32_t v = 0;
+	memcpy (&v, &r->rxData[r->rxRead/8], (n+7)/8);
+	if (n < 32) {
+		v &= (UINT32_C(1) << n) - 1;
+	}
+	*block = v;
+	*bits = n;
+	r->rxRead += n;
+	return true;
+}
+
+/* ===== misc ===== */
+
+XMC_GPIO_PORT_t simGpioPort[3];
+bool simVerbose = false;
+
+int SEGGER_RTT_printf (unsigned int buffer, const char * fmt, ...) {
+	if (!simVerbose) {
+		return 0;
+	}
+	va_list ap;
+	va_start (ap, fmt);
+	fprintf (stderr, "%10.3f ms: ", (double) simNow ()/SIM_MS);
+	const int ret = vfprintf (stderr, fmt, ap);
+	va_end (ap);
+	return ret;
+}
+
+unsigned int SEGGER_RTT_Write (unsigned int buffer, const void * data,
+		unsigned int size) {
+	return size;
+}
+
+unsigned int SEGGER_RTT_WriteString (unsigned int buffer, const char * s) {
+	if (simVerbose) {
+		fputs (s, stderr);
+	}
+	return strlen (s);
+}
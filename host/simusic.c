@@ -0,0 +1,180 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*	Simulated USIC channel, see host/include/xmc_usic.h
+ */
+
+#include <assert.h>
+
+#include <xmc_usic.h>
+
+void simUsicInit (XMC_USIC_CH_t * const channel) {
+	memset (channel, 0, sizeof (*channel));
+}
+
+void XMC_USIC_CH_TXFIFO_Configure (XMC_USIC_CH_t * const channel,
+		const uint32_t dataPointer, const XMC_USIC_CH_FIFO_SIZE_t size,
+		const uint32_t limit) {
+	assert (size == XMC_USIC_CH_FIFO_SIZE_32WORDS);
+	assert (limit < SIM_USIC_FIFO_SIZE);
+	channel->txLimit = limit;
+	XMC_USIC_CH_TXFIFO_Flush (channel);
+}
+
+void XMC_USIC_CH_RXFIFO_Configure (XMC_USIC_CH_t * const channel,
+		const uint32_t dataPointer, const XMC_USIC_CH_FIFO_SIZE_t size,
+		const uint32_t limit) {
+	assert (size == XMC_USIC_CH_FIFO_SIZE_32WORDS);
+	XMC_USIC_CH_RXFIFO_Flush (channel);
+}
+
+void XMC_USIC_CH_TXFIFO_SetInterruptNodePointer (XMC_USIC_CH_t * const channel,
+		const XMC_USIC_CH_TXFIFO_INTERRUPT_NODE_POINTER_t node,
+		const uint32_t sr) {
+	/* there is only one service request line */
+	assert (sr == 0);
+}
+
+void XMC_USIC_CH_TXFIFO_EnableEvent (XMC_USIC_CH_t * const channel,
+		const uint32_t event) {
+	assert (event == XMC_USIC_CH_TXFIFO_EVENT_CONF_STANDARD);
+	channel->txEventEnabled = true;
+}
+
+void XMC_USIC_CH_TXFIFO_DisableEvent (XMC_USIC_CH_t * const channel,
+		const uint32_t event) {
+	assert (event == XMC_USIC_CH_TXFIFO_EVENT_CONF_STANDARD);
+	channel->txEventEnabled = false;
+}
+
+uint32_t XMC_USIC_CH_TXFIFO_GetEvent (XMC_USIC_CH_t * const channel) {
+	return channel->txEvents;
+}
+
+void XMC_USIC_CH_TXFIFO_ClearEvent (XMC_USIC_CH_t * const channel,
+		const uint32_t event) {
+	channel->txEvents &= ~event;
+}
+
+void XMC_USIC_CH_TXFIFO_Flush (XMC_USIC_CH_t * const channel) {
+	channel->txRead = 0;
+	channel->txLevel = 0;
+}
+
+bool XMC_USIC_CH_TXFIFO_IsFull (XMC_USIC_CH_t * const channel) {
+	return channel->txLevel == SIM_USIC_FIFO_SIZE;
+}
+
+static void txPut (XMC_USIC_CH_t * const channel, const uint32_t word) {
+	/* real hardware silently drops the word */
+	assert (!XMC_USIC_CH_TXFIFO_IsFull (channel));
+	channel->tx[(channel->txRead+channel->txLevel)%SIM_USIC_FIFO_SIZE] = word;
+	++channel->txLevel;
+}
+
+void XMC_USIC_CH_TXFIFO_PutData (XMC_USIC_CH_t * const channel,
+		const uint16_t data) {
+	txPut (channel, data);
+}
+
+void XMC_USIC_CH_TXFIFO_PutDataFLEMode (XMC_USIC_CH_t * const channel,
+		const uint16_t data, const uint32_t frameLength) {
+	txPut (channel, SIM_USIC_BREAK | data);
+}
+
+void XMC_USIC_CH_RXFIFO_Flush (XMC_USIC_CH_t * const channel) {
+	channel->rxRead = 0;
+	channel->rxLevel = 0;
+}
+
+bool XMC_USIC_CH_RXFIFO_IsEmpty (XMC_USIC_CH_t * const channel) {
+	return channel->rxLevel == 0;
+}
+
+uint32_t XMC_USIC_CH_RXFIFO_GetLevel (XMC_USIC_CH_t * const channel) {
+	return channel->rxLevel;
+}
+
+/*	Reading an empty fifo returns the last word on real hardware, zero here
+ */
+uint16_t XMC_USIC_CH_RXFIFO_GetData (XMC_USIC_CH_t * const channel) {
+	if (channel->rxLevel == 0) {
+		return 0;
+	}
+	const uint8_t data = channel->rx[channel->rxRead];
+	channel->rxRead = (channel->rxRead+1)%SIM_USIC_FIFO_SIZE;
+	--channel->rxLevel;
+	return data;
+}
+
+/*	Master sends request data and asserts slave select again, which raises
+ *	status flag. Returns false if the receive fifo overflowed.
+ */
+bool simUsicRequest (XMC_USIC_CH_t * const channel, const uint8_t * const data,
+		const size_t size, const uint32_t flag) {
+	bool ok = true;
+	for (size_t i = 0; i < size; i++) {
+		if (channel->rxLevel == SIM_USIC_FIFO_SIZE) {
+			ok = false;
+			break;
+		}
+		channel->rx[(channel->rxRead+channel->rxLevel)%SIM_USIC_FIFO_SIZE] =
+				data[i];
+		++channel->rxLevel;
+	}
+	channel->status |= flag;
+	/* protocol event enable bits match their status flags */
+	if (channel->events & flag) {
+		channel->irq = true;
+	}
+	return ok;
+}
+
+/*	Master clocks one word out of the transmit fifo. Returns false on
+ *	underrun, word is zero (passive level) then.
+ */
+bool simUsicClock (XMC_USIC_CH_t * const channel, uint32_t * const word) {
+	if (channel->txDisabled || channel->txLevel == 0) {
+		++channel->underruns;
+		*word = 0;
+		return false;
+	}
+	*word = channel->tx[channel->txRead];
+	channel->txRead = (channel->txRead+1)%SIM_USIC_FIFO_SIZE;
+	--channel->txLevel;
+	/* standard event: level equals the limit and gets lower */
+	if (channel->txLevel+1 == channel->txLimit) {
+		channel->txEvents |= XMC_USIC_CH_TXFIFO_EVENT_STANDARD;
+		if (channel->txEventEnabled) {
+			channel->irq = true;
+		}
+	}
+	return true;
+}
+
+/*	Is the service request pending? Clears it.
+ */
+bool simUsicIrq (XMC_USIC_CH_t * const channel) {
+	const bool ret = channel->irq;
+	channel->irq = false;
+	return ret;
+}
@@ -0,0 +1,599 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*	Drives spiclient.c as SPI master against the simulated USIC channel and
+ *	checks every response, with the tx fifo refill interrupt served a
+ *	configurable number of words late.
+ */
+
+#include <assert.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xmc_spi.h>
+#include <xmc_ccu4.h>
+#include <SEGGER_RTT.h>
+
+#include "spiclient.h"
+#include "crc32.h"
+#include "util.h"
+
+XMC_GPIO_PORT_t simGpioPort[3];
+bool simVerbose = false;
+
+int SEGGER_RTT_printf (unsigned int buffer, const char * fmt, ...) {
+	if (!simVerbose) {
+		return 0;
+	}
+	va_list ap;
+	va_start (ap, fmt);
+	const int ret = vfprintf (stderr, fmt, ap);
+	va_end (ap);
+	return ret;
+}
+
+unsigned int SEGGER_RTT_Write (unsigned int buffer, const void * data,
+		unsigned int size) {
+	return size;
+}
+
+unsigned int SEGGER_RTT_WriteString (unsigned int buffer, const char * s) {
+	return strlen (s);
+}
+
+int SEGGER_RTT_ConfigUpBuffer (unsigned int buffer, const char * name,
+		void * data, unsigned int size, unsigned int flags) {
+	return 0;
+}
+
+/* the timer service’s clock only advances when the harness says so, see
+ * advance */
+static XMC_CCU4_MODULE_t ccu4;
+XMC_CCU4_MODULE_t *simCcu4 = &ccu4;
+
+void XMC_CCU4_SetModuleClock (XMC_CCU4_MODULE_t * const module,
+		const XMC_CCU4_CLOCK_t clock) {
+}
+
+void XMC_CCU4_Init (XMC_CCU4_MODULE_t * const module,
+		const XMC_CCU4_SLICE_MCMS_ACTION_t action) {
+}
+
+void XMC_CCU4_StartPrescaler (XMC_CCU4_MODULE_t * const module) {
+}
+
+void XMC_CCU4_EnableClock (XMC_CCU4_MODULE_t * const module,
+		const uint8_t slice) {
+}
+
+void XMC_CCU4_EnableShadowTransfer (XMC_CCU4_MODULE_t * const module,
+		const uint32_t mask) {
+	for (uint8_t i = 0; i < arraysize (module->cc); i++) {
+		module->cc[i].period = module->cc[i].periodShadow;
+	}
+}
+
+void XMC_CCU4_SLICE_CompareInit (XMC_CCU4_SLICE_t * const slice,
+		const XMC_CCU4_SLICE_COMPARE_CONFIG_t * const config) {
+	slice->monoshot = config->monoshot;
+}
+
+void XMC_CCU4_SLICE_StartTimer (XMC_CCU4_SLICE_t * const slice) {
+	slice->running = true;
+}
+
+void XMC_CCU4_SLICE_StopTimer (XMC_CCU4_SLICE_t * const slice) {
+	slice->running = false;
+}
+
+void XMC_CCU4_SLICE_ClearTimer (XMC_CCU4_SLICE_t * const slice) {
+	slice->timer = 0;
+}
+
+uint16_t XMC_CCU4_SLICE_GetTimerValue (XMC_CCU4_SLICE_t * const slice) {
+	return slice->timer;
+}
+
+void XMC_CCU4_SLICE_SetTimerPeriodMatch (XMC_CCU4_SLICE_t * const slice,
+		const uint16_t value) {
+	slice->periodShadow = value;
+}
+
+void XMC_CCU4_SLICE_EnableEvent (XMC_CCU4_SLICE_t * const slice,
+		const XMC_CCU4_SLICE_IRQ_ID_t event) {
+	slice->events |= 1U << event;
+}
+
+void XMC_CCU4_SLICE_ClearEvent (XMC_CCU4_SLICE_t * const slice,
+		const XMC_CCU4_SLICE_IRQ_ID_t event) {
+}
+
+void XMC_CCU4_SLICE_SetInterruptNode (XMC_CCU4_SLICE_t * const slice,
+		const XMC_CCU4_SLICE_IRQ_ID_t event, const XMC_CCU4_SLICE_SR_ID_t sr) {
+}
+
+/* spiclient’s interrupt handler, see ISR there */
+void USIC1_0_IRQHandler (void);
+
+/* commands and registers, see spiclient.c */
+enum {
+	CMD_READBUF = 0x1,
+	CMD_READREG = 0x3,
+	CMD_WRITEREG = 0x4,
+	CMD_READBUFS = 0x5,
+	CMD_WRITEBUFS = 0x6,
+};
+
+enum {
+	REG_RXPENDING = 0x2,
+	REG_CONFIG = 0x5,
+	REG_CORRECTED = 0x6,
+	REG_IRQPACKETS = 0x8,
+	REG_IRQTIMEOUT = 0x9,
+};
+
+/* host interrupt line, low-active */
+#define INTERRUPT_PORT (simGpioPort[0])
+#define INTERRUPT_PIN (12)
+#define SLICE_ALARM (&ccu4.cc[3])
+
+typedef struct {
+	XMC_USIC_CH_t dev;
+	spiclient client;
+	/* words clocked between service request and interrupt */
+	unsigned int latency;
+	/* words left until the pending interrupt runs, -1 if none */
+	int irqIn;
+	unsigned int triggered;
+	/* train length passed to initMac */
+	uint8_t train;
+	uint64_t responses, packets, bytes, refills, underruns, errors;
+	size_t maxResponse;
+} spisim;
+
+static void initMac (void * data, const uint8_t i, const uint8_t n,
+		const uint8_t payloadSize, const uint8_t train, const uint8_t encoder) {
+	spisim * const s = data;
+	s->train = train;
+}
+
+static void triggerSend (void * data) {
+	spisim * const s = data;
+	++s->triggered;
+}
+
+static void setGroups (void * data, const uint32_t groups) {
+}
+
+/*	Send request and assert slave select again, spiclient answers immediately
+ */
+static void request (spisim * const s, const uint8_t * const data,
+		const size_t size) {
+	const bool ok = simUsicRequest (&s->dev, data, size,
+			XMC_SPI_CH_STATUS_FLAG_DX2T_EVENT_DETECTED);
+	assert (ok);
+	simUsicIrq (&s->dev);
+	s->irqIn = -1;
+	USIC1_0_IRQHandler ();
+}
+
+/*	Clock one word, serving the refill interrupt latency words after it was
+ *	requested. Returns false on underrun.
+ */
+static bool clockWord (spisim * const s, uint8_t * const byte) {
+	uint32_t word;
+	const bool ok = simUsicClock (&s->dev, &word);
+	*byte = word;
+	if (s->irqIn < 0 && simUsicIrq (&s->dev)) {
+		s->irqIn = s->latency;
+	}
+	if (s->irqIn == 0) {
+		USIC1_0_IRQHandler ();
+		++s->refills;
+		s->irqIn = -1;
+	} else if (s->irqIn > 0) {
+		--s->irqIn;
+	}
+	return ok;
+}
+
+static bool readBytes (spisim * const s, uint8_t * const buf, const size_t size) {
+	for (size_t i = 0; i < size; i++) {
+		if (!clockWord (s, &buf[i])) {
+			++s->underruns;
+			return false;
+		}
+	}
+	s->bytes += size;
+	return true;
+}
+
+/*	Wait for the start marker
+ */
+static bool responseBegin (spisim * const s) {
+	uint8_t b;
+	for (unsigned int i = 0; i < 4; i++) {
+		if (clockWord (s, &b) && b == 0xaa) {
+			return true;
+		}
+	}
+	return false;
+}
+
+/*	Check end marker, the fifo must be empty and its refill interrupt off
+ *	afterwards
+ */
+static bool responseEnd (spisim * const s, const size_t len) {
+	uint8_t b;
+	if (!readBytes (s, &b, 1) || b != 0xff) {
+		return false;
+	}
+	++s->responses;
+	if (len+2 > s->maxResponse) {
+		s->maxResponse = len+2;
+	}
+	return s->dev.txLevel == 0 && !s->dev.txEventEnabled;
+}
+
+static void check (spisim * const s, const bool ok, const char * const what) {
+	if (!ok) {
+		++s->errors;
+		if (simVerbose) {
+			fprintf (stderr, "latency %u: %s failed\n", s->latency, what);
+		}
+	}
+}
+
+/*	Queue count random packets and read them back with READBUFS or one by one
+ *	with READBUF
+ */
+static void roundRead (spisim * const s, const unsigned int count,
+		const uint8_t payload, const bool batch) {
+	uint8_t expect[SPICLIENT_FIFO_SLOTS][1+FMAC_MAX_PAYLOAD_LEN];
+	for (unsigned int i = 0; i < count; i++) {
+		expect[i][0] = 1 + rand () % payload;
+		for (unsigned int j = 0; j < expect[i][0]; j++) {
+			expect[i][1+j] = rand ();
+		}
+		const bool ok = spiclientRx (&s->client, &expect[i][1], expect[i][0]);
+		assert (ok);
+	}
+
+	uint8_t buf[1+FMAC_MAX_PAYLOAD_LEN];
+	if (batch) {
+		const uint8_t cmd = CMD_READBUFS;
+		request (s, &cmd, sizeof (cmd));
+		uint8_t header[3];
+		if (!responseBegin (s) || !readBytes (s, header, sizeof (header)) ||
+				header[0] != 0 || header[1] != 0 || header[2] != count) {
+			check (s, false, "readbufs header");
+			return;
+		}
+		size_t len = sizeof (header);
+		for (unsigned int i = 0; i < count; i++) {
+			if (!readBytes (s, buf, 1) || !readBytes (s, &buf[1], buf[0]) ||
+					memcmp (buf, expect[i], 1+expect[i][0]) != 0) {
+				check (s, false, "readbufs packet");
+				return;
+			}
+			len += 1+buf[0];
+			++s->packets;
+		}
+		check (s, responseEnd (s, len), "readbufs end");
+	} else {
+		for (unsigned int i = 0; i < count; i++) {
+			const uint8_t cmd = CMD_READBUF;
+			request (s, &cmd, sizeof (cmd));
+			if (!responseBegin (s) || !readBytes (s, buf, 1) ||
+					!readBytes (s, &buf[1], buf[0]) ||
+					memcmp (buf, expect[i], 1+expect[i][0]) != 0) {
+				check (s, false, "readbuf packet");
+				/* drop the rest, the next round starts with an empty fifo */
+				while (fifoPop (&s->client.rxFifo) != NULL);
+				return;
+			}
+			++s->packets;
+			check (s, responseEnd (s, 1+buf[0]), "readbuf end");
+		}
+	}
+}
+
+/*	Write two packets with WRITEBUFS and pop them like the MAC would
+ */
+static void roundWrite (spisim * const s, const uint8_t payload) {
+	uint8_t req[32];
+	size_t pos = 0;
+	req[pos++] = CMD_WRITEBUFS;
+	req[pos++] = 2;
+	const uint8_t maxLen = payload < 12 ? payload : 12;
+	const size_t first = pos;
+	for (unsigned int i = 0; i < 2; i++) {
+		const uint8_t len = 1 + rand () % maxLen;
+		req[pos++] = len;
+		req[pos++] = FMAC_ADDR_BROADCAST;
+		for (unsigned int j = 0; j < len; j++) {
+			req[pos++] = rand ();
+		}
+	}
+	s->triggered = 0;
+	request (s, req, pos);
+	uint8_t header[3];
+	check (s, responseBegin (s) && readBytes (s, header, sizeof (header)) &&
+			header[1] == 2 && header[2] == 2 && responseEnd (s, 3) &&
+			s->triggered == 1, "writebufs");
+
+	pos = first;
+	for (unsigned int i = 0; i < 2; i++) {
+		const void *data;
+		size_t size;
+		uint8_t dest;
+		const bool ok = spiclientTx (&s->client, &data, &size, &dest);
+		check (s, ok && size == req[pos] && dest == req[pos+1] &&
+				memcmp (data, &req[pos+2], size) == 0, "writebufs packet");
+		pos += 2+req[pos];
+	}
+}
+
+/*	A WRITEBUFS request longer than the usic rx fifo is rejected as a whole
+ */
+static void roundWriteOverflow (spisim * const s, const uint8_t payload) {
+	uint8_t req[SIM_USIC_FIFO_SIZE+3+FMAC_MAX_PAYLOAD_LEN];
+	size_t pos = 0;
+	req[pos++] = CMD_WRITEBUFS;
+	req[pos++] = 0;
+	while (pos <= SIM_USIC_FIFO_SIZE) {
+		req[pos++] = payload;
+		req[pos++] = FMAC_ADDR_BROADCAST;
+		memset (&req[pos], 0x55, payload);
+		pos += payload;
+		++req[1];
+	}
+	s->triggered = 0;
+	const bool fits = simUsicRequest (&s->dev, req, pos,
+			XMC_SPI_CH_STATUS_FLAG_DX2T_EVENT_DETECTED);
+	simUsicIrq (&s->dev);
+	s->irqIn = -1;
+	USIC1_0_IRQHandler ();
+	uint8_t header[3];
+	const void *data;
+	size_t size;
+	uint8_t dest;
+	check (s, !fits && responseBegin (s) &&
+			readBytes (s, header, sizeof (header)) && header[1] == 0 &&
+			header[2] == 0 && responseEnd (s, 3) && s->triggered == 0 &&
+			!spiclientTx (&s->client, &data, &size, &dest), "writebufs overflow");
+}
+
+static bool irqLine (void) {
+	return !(INTERRUPT_PORT.out & (1U << INTERRUPT_PIN));
+}
+
+static void writeReg (spisim * const s, const uint8_t reg, const uint32_t val) {
+	const uint8_t req[] = {CMD_WRITEREG, reg, val, val >> 8, val >> 16,
+			val >> 24};
+	request (s, req, sizeof (req));
+}
+
+static bool readReg (spisim * const s, const uint8_t reg, uint32_t * const val) {
+	const uint8_t req[] = {CMD_READREG, reg};
+	request (s, req, sizeof (req));
+	uint8_t buf[4];
+	if (!responseBegin (s) || !readBytes (s, buf, sizeof (buf)) ||
+			!responseEnd (s, sizeof (buf))) {
+		return false;
+	}
+	*val = buf[0] | buf[1] << 8 | buf[2] << 16 | (uint32_t) buf[3] << 24;
+	return true;
+}
+
+static bool drain (spisim * const s, const unsigned int count) {
+	const uint8_t cmd = CMD_READBUFS;
+	request (s, &cmd, sizeof (cmd));
+	uint8_t header[3], buf[1+FMAC_MAX_PAYLOAD_LEN];
+	if (!responseBegin (s) || !readBytes (s, header, sizeof (header)) ||
+			header[2] != count) {
+		return false;
+	}
+	for (unsigned int i = 0; i < count; i++) {
+		if (!readBytes (s, buf, 1) || !readBytes (s, &buf[1], buf[0])) {
+			return false;
+		}
+	}
+	return responseEnd (s, 0);
+}
+
+/*	Move the timer service’s clock, made of slices 0 and 1, forward and run
+ *	the alarm interrupt if it expired
+ */
+static void advance (const uint32_t ticks) {
+	const uint32_t t = timerNow () + ticks;
+	ccu4.cc[0].timer = t & 0xffff;
+	ccu4.cc[1].timer = t >> 16;
+	if (SLICE_ALARM->running) {
+		timerIrqHandle ();
+	}
+}
+
+/*	Line is held once three packets are pending or the timeout expired, until
+ *	the fifo is drained
+ */
+static void roundCoalesce (spisim * const s) {
+	const uint8_t p = 1;
+	writeReg (s, REG_IRQPACKETS, 3);
+	writeReg (s, REG_IRQTIMEOUT, 1000);
+
+	spiclientRx (&s->client, &p, sizeof (p));
+	check (s, !irqLine () && timerPending (&s->client.timeout) &&
+			s->client.timeout.deadline == timerNow () + TIMER_US_TO_TICKS (1000),
+			"coalesce timer");
+	spiclientRx (&s->client, &p, sizeof (p));
+	check (s, !irqLine (), "coalesce below threshold");
+	spiclientRx (&s->client, &p, sizeof (p));
+	check (s, irqLine () && !timerPending (&s->client.timeout),
+			"coalesce threshold");
+	check (s, drain (s, 3) && !irqLine (), "coalesce drained");
+
+	spiclientRx (&s->client, &p, sizeof (p));
+	advance (TIMER_US_TO_TICKS (999));
+	check (s, !irqLine (), "coalesce before timeout");
+	advance (TIMER_US_TO_TICKS (1));
+	check (s, irqLine () && !SLICE_ALARM->running, "coalesce timeout");
+	spiclientRx (&s->client, &p, sizeof (p));
+	check (s, irqLine (), "coalesce held");
+	check (s, drain (s, 2) && !irqLine (), "coalesce timeout drained");
+
+	/* back to one wakeup per packet */
+	writeReg (s, REG_IRQPACKETS, 1);
+	writeReg (s, REG_IRQTIMEOUT, 0);
+	spiclientRx (&s->client, &p, sizeof (p));
+	check (s, irqLine (), "no coalescing");
+	check (s, drain (s, 1) && !irqLine (), "no coalescing drained");
+}
+
+static void run (spisim * const s, const unsigned int rounds,
+		const uint8_t payload) {
+	simUsicInit (&s->dev);
+	memset (&s->client, 0, sizeof (s->client));
+	s->client.initMac = initMac;
+	s->client.triggerSend = triggerSend;
+	s->client.setGroups = setGroups;
+	s->client.macData = s;
+	timerInit (0);
+	spiclientInit (&s->client, &s->dev, 0);
+
+	/* too long trains are capped */
+	const uint8_t config[] = {CMD_WRITEREG, REG_CONFIG, 0, 2, payload, 0x1f};
+	s->train = 0;
+	request (s, config, sizeof (config));
+	check (s, s->train == 0, "config deferred");
+	/* main loop */
+	spiclientProcess (&s->client);
+	check (s, !irqLine (), "idle line");
+	const uint8_t maxTrain = fmacMaxTrain (payload);
+	check (s, s->train == (maxTrain < SPICLIENT_FIFO_SLOTS-1 ? maxTrain :
+			SPICLIENT_FIFO_SLOTS-1), "train capped");
+	/* unknown encoders are ignored */
+	const uint8_t badEncoder[] = {CMD_WRITEREG, REG_CONFIG, 0, 2, payload, 0xe1};
+	s->train = 0;
+	request (s, badEncoder, sizeof (badEncoder));
+	spiclientProcess (&s->client);
+	check (s, s->train == 0, "invalid encoder");
+
+	/* the decoder’s counters keep running, reads report the difference */
+	uint32_t corrected;
+	crc32Statistics.burst += 2;
+	crc32Statistics.twoBit += 1;
+	check (s, readReg (s, REG_CORRECTED, &corrected) &&
+			corrected == 0x00020001, "corrected");
+	check (s, readReg (s, REG_CORRECTED, &corrected) && corrected == 0,
+			"corrected reset");
+
+	roundCoalesce (s);
+	roundWriteOverflow (s, payload);
+
+	for (unsigned int r = 0; r < rounds; r++) {
+		roundRead (s, 1 + rand () % (SPICLIENT_FIFO_SLOTS-1), payload,
+				r % 4 != 0);
+		if (r % 8 == 0) {
+			roundWrite (s, payload);
+		}
+		if (r % 16 == 0) {
+			uint32_t pending;
+			check (s, readReg (s, REG_RXPENDING, &pending) && pending == 0,
+					"rxpending");
+		}
+	}
+}
+
+static void usage (const char * const name) {
+	fprintf (stderr, "Usage: %s [-l latency,...] [-p payload] [-r rounds] "
+			"[-s seed] [-v]\n"
+			"latency is the number of words the master clocks before the "
+			"refill interrupt runs.\n", name);
+}
+
+int main (int argc, char **argv) {
+	unsigned int latency[32] = {0, 8, 15, 16, 24}, latencies = 5;
+	unsigned int rounds = 10000, seed = 1;
+	uint8_t payload = FMAC_MAX_PAYLOAD_LEN;
+
+	int opt;
+	while ((opt = getopt (argc, argv, "l:p:r:s:v")) != -1) {
+		switch (opt) {
+			case 'l': {
+				latencies = 0;
+				for (char *tok = strtok (optarg, ","); tok != NULL &&
+						latencies < arraysize (latency);
+						tok = strtok (NULL, ",")) {
+					latency[latencies++] = atoi (tok);
+				}
+				break;
+			}
+
+			case 'p':
+				payload = atoi (optarg);
+				break;
+
+			case 'r':
+				rounds = atoi (optarg);
+				break;
+
+			case 's':
+				seed = atoi (optarg);
+				break;
+
+			case 'v':
+				simVerbose = true;
+				break;
+
+			default:
+				usage (argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+	if (payload == 0 || payload > FMAC_MAX_PAYLOAD_LEN || latencies == 0) {
+		usage (argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	printf ("%7s %9s %9s %9s %8s %7s %9s %7s\n", "latency", "responses",
+			"packets", "bytes", "maxresp", "refills", "underruns", "errors");
+	bool failed = false;
+	for (unsigned int i = 0; i < latencies; i++) {
+		spisim s;
+		memset (&s, 0, sizeof (s));
+		s.latency = latency[i];
+		s.irqIn = -1;
+		srand (seed);
+		run (&s, rounds, payload);
+		printf ("%7u %9lu %9lu %9lu %8zu %7lu %9lu %7lu\n", s.latency,
+				s.responses, s.packets, s.bytes, s.maxResponse, s.refills,
+				s.underruns, s.errors);
+		/* the fifo drains from the limit to empty in limit-1 more words */
+		failed = failed || (s.latency < s.dev.txLimit && s.errors > 0);
+	}
+
+	return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,256 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*	Packet error rate of framelets on a binary symmetric channel, with
+ *	and without majority voting of failed repetitions. Mirrors the receive
+ *	path in fmac.c: every packet is received n times with independent bit
+ *	errors, failed copies are kept in a ring and voted on once three or more
+ *	are available.
+ */
+
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <SEGGER_RTT.h>
+
+#include "fmac.h"
+#include "packet.h"
+
+/* runin and tsi are stripped by the tda */
+#define PREAMBLE_BITS (24)
+
+bool simVerbose = false;
+
+/* decoder messages are not interesting here */
+int SEGGER_RTT_printf (unsigned int buffer, const char * fmt, ...) {
+	return 0;
+}
+
+unsigned int SEGGER_RTT_Write (unsigned int buffer, const void * data,
+		unsigned int size) {
+	return size;
+}
+
+unsigned int SEGGER_RTT_WriteString (unsigned int buffer, const char * s) {
+	return strlen (s);
+}
+
+static uint64_t rng = 1;
+
+static uint64_t random64 (void) {
+	/* xorshift64* */
+	rng ^= rng >> 12;
+	rng ^= rng << 25;
+	rng ^= rng >> 27;
+	return rng * UINT64_C(2685821657736338717);
+}
+
+static double randomUniform (void) {
+	return (double) (random64 () >> 11) * (1.0/9007199254740992.0);
+}
+
+/*	Flip every bit with probability ber
+ */
+static void channel (uint32_t * const buf, const size_t bits, const double ber) {
+	if (ber <= 0) {
+		return;
+	}
+	/* skip to the next error, geometric distribution */
+	const double l = log (1.0 - ber);
+	size_t i = 0;
+	while (true) {
+		i += (size_t) (log (1.0 - randomUniform ())/l);
+		if (i >= bits) {
+			break;
+		}
+		buf[i/32] ^= UINT32_C(1) << (i%32);
+		++i;
+	}
+}
+
+typedef struct {
+	uint32_t buf[FMAC_VOTE_COPIES][FMAC_MAX_PACKET_LEN/4];
+	size_t bits[FMAC_VOTE_COPIES];
+	unsigned int count, next;
+} voteRing;
+
+/* corrupted packets the decoder accepted */
+static unsigned long undetected = 0;
+
+static bool decodeAs (const packetEncoder * const enc,
+		const uint32_t * const raw, const size_t bits,
+		const uint8_t * const expect, const size_t expectLen) {
+	uint8_t dec[FMAC_MAX_PACKET_LEN];
+	size_t len;
+	if (enc->decode ((const uint8_t *) raw, bits, dec, sizeof (dec), &len) !=
+			PACKET_DECODE_OK) {
+		return false;
+	}
+	if (len != expectLen || memcmp (dec, expect, len) != 0) {
+		++undetected;
+		return false;
+	}
+	return true;
+}
+
+/*	Same as vote () in fmac.c
+ */
+static bool vote (voteRing * const r, const packetEncoder * const enc,
+		const uint32_t * const raw, const size_t bits,
+		const uint8_t * const expect, const size_t expectLen) {
+	memcpy (r->buf[r->next], raw, sizeof (r->buf[r->next]));
+	r->bits[r->next] = bits;
+	r->next = (r->next+1)%FMAC_VOTE_COPIES;
+	if (r->count < FMAC_VOTE_COPIES) {
+		++r->count;
+	}
+	if (r->count < 3) {
+		return false;
+	}
+
+	const uint32_t *copies[FMAC_VOTE_COPIES];
+	size_t minBits = SIZE_MAX;
+	for (unsigned int j = 0; j < r->count; j++) {
+		copies[j] = r->buf[j];
+		if (r->bits[j] < minBits) {
+			minBits = r->bits[j];
+		}
+	}
+	uint32_t voted[FMAC_MAX_PACKET_LEN/4];
+	packetVote (voted, copies, r->count, (minBits+31)/32);
+	if (decodeAs (enc, voted, minBits, expect, expectLen)) {
+		r->count = 0;
+		r->next = 0;
+		return true;
+	}
+	return false;
+}
+
+static void usage (const char * const name) {
+	fprintf (stderr, "Usage: %s [-n repetitions] [-p payload] [-c packets] "
+			"[-s seed] [-e 8b10b|rs|scrambled] ber...\n", name);
+}
+
+int main (int argc, char **argv) {
+	unsigned int n = 3, payload = 16, packets = 100000;
+	int opt;
+	const char *encoder = "8b10b";
+
+	while ((opt = getopt (argc, argv, "n:p:c:s:e:")) != -1) {
+		switch (opt) {
+			case 'n':
+				n = atoi (optarg);
+				break;
+
+			case 'p':
+				payload = atoi (optarg);
+				break;
+
+			case 'c':
+				packets = atoi (optarg);
+				break;
+
+			case 's':
+				rng = strtoull (optarg, NULL, 0);
+				break;
+
+			case 'e':
+				encoder = optarg;
+				break;
+
+			default:
+				usage (argv[0]);
+				return EXIT_FAILURE;
+		}
+	}
+	if (optind >= argc || n < 1 || payload < 1 ||
+			payload+FMAC_HEADER_LEN > FMAC_MAX_BODY_LEN || rng == 0) {
+		usage (argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	packetCrcInit ();
+	packetEncoder enc;
+	if (strcmp (encoder, "8b10b") == 0) {
+		packet8b10bInit (&enc);
+	} else if (strcmp (encoder, "rs") == 0) {
+		packetRsInit (&enc);
+	} else if (strcmp (encoder, "scrambled") == 0) {
+		packetScrambledInit (&enc);
+	} else {
+		usage (argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	printf ("%10s %9s %3s %4s %10s %10s %8s %10s\n", "ber", "enc", "n", "pl",
+			"per", "per vote", "voted", "undetected");
+	for (int a = optind; a < argc; a++) {
+		const double ber = atof (argv[a]);
+		voteRing ring = { .count = 0, .next = 0 };
+		unsigned long lost = 0, lostVote = 0, voted = 0;
+		undetected = 0;
+
+		for (unsigned int i = 0; i < packets; i++) {
+			uint8_t body[FMAC_MAX_BODY_LEN];
+			const size_t bodyLen = payload+FMAC_HEADER_LEN;
+			for (size_t j = 0; j < bodyLen; j++) {
+				body[j] = random64 ();
+			}
+			uint8_t tx[FMAC_MAX_PACKET_LEN];
+			const size_t txBits = enc.encode (body, bodyLen, tx, sizeof (tx));
+			const size_t bits = txBits - PREAMBLE_BITS;
+
+			bool ok = false, okVote = false;
+			for (unsigned int j = 0; j < n; j++) {
+				uint32_t raw[FMAC_MAX_PACKET_LEN/4];
+				memset (raw, 0, sizeof (raw));
+				memcpy (raw, &tx[PREAMBLE_BITS/8], (bits+7)/8);
+				channel (raw, bits, ber);
+
+				if (decodeAs (&enc, raw, bits, body, bodyLen)) {
+					ok = true;
+					okVote = true;
+					ring.count = 0;
+					ring.next = 0;
+				} else if (vote (&ring, &enc, raw, bits, body, bodyLen)) {
+					if (!okVote && !ok) {
+						++voted;
+					}
+					okVote = true;
+				}
+			}
+			lost += !ok;
+			lostVote += !okVote;
+		}
+
+		printf ("%10.2e %9s %3u %4u %10.2e %10.2e %8lu %10lu\n", ber, encoder,
+				n, payload, (double) lost/packets, (double) lostVote/packets, voted,
+				undetected);
+	}
+
+	return EXIT_SUCCESS;
+}
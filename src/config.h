@@ -24,8 +24,11 @@ THE SOFTWARE.
 
 /* user/application configuration */
 
+/* host interface, bin/spisim builds with -DUSE_SPI */
+#if !defined(USE_SPI) && !defined(USE_UART)
 //#define USE_SPI
 #define USE_UART
+#endif
 
 #if 0
 /* fixed parameters for debugging without SPI adapter */
@@ -51,6 +54,42 @@ THE SOFTWARE.
 
 #define TDA_BAUDRATE (2000000)
 
+/* crc32 implementation (see crc32.h), trades memory for speed. slice-by-8
+ * needs 8 KiB of RAM, the XMC1100 only has 16 KiB */
+#if UC_SERIES == XMC11
+#define CRC32_IMPL CRC32_NIBBLE
+#elif UC_SERIES == XMC45
+#define CRC32_IMPL CRC32_SLICE8
+#endif
+
+/* crc error correction beyond single bits, see crc32Correct. Max burst length
+ * in bits (0 disables), up to 6 with two bit correction, 10 without. Off by
+ * default, each pattern corrected also turns some heavily corrupted packets
+ * into wrong ones */
+#define CRC32_CORRECT_BURST (0)
+//#define CRC32_CORRECT_TWOBIT
+
+/* crc at the end of every framelet, 8, 16 or 32 bits. Shorter crcs make
+ * framelets and thus δ shorter, but detect fewer corrupted packets. crc16 and
+ * crc8 only correct single bit errors */
+#define PACKET_CRC_BITS (32)
+/* with 8 check bits almost every syndrome points to some bit of the message,
+ * so correction accepts most corrupted packets */
+//#define CRC8_CORRECT
+
+/* default packet encoder (see packet.h) until the host writes CONFIG: 8b10b
+ * line code with crc correction, interleaved reed-solomon, whitened nrz or
+ * none. Also used by the simulator */
+#define PACKET_ENCODER PACKET_8B10B
+
+/* only queue received framelets in the tda interrupt, decode and deliver
+ * them from the main loop (fmacProcess). Without it the framelet is decoded
+ * while it is drained from the fifo (streaming decode), -DFMAC_NO_DEFER_RX
+ * builds that variant, see bin/sim-nodefer */
+#ifndef FMAC_NO_DEFER_RX
+#define FMAC_DEFER_RX
+#endif
+
 /* hardware units used */
 #if UC_SERIES == XMC45
 #include <xmc_gpio.h>
@@ -25,6 +25,7 @@ THE SOFTWARE.
 #include <SEGGER_RTT.h>
 
 #include "util.h"
+#include "crc32.h"
 
 /*----------------------------------------------------------------------------*\
  *  CRC-32 version 2.0.0 by Craig Bruce, 2006-04-29.
@@ -65,75 +66,75 @@ THE SOFTWARE.
  *     (no errors are possible)
 \*----------------------------------------------------------------------------*/
 
-_unused_ static uint32_t crc32 (uint32_t inCrc32, const void *buf, size_t bufLen) {
-	/* using #define TB_POLY   0x04C11DB7L, #define TB_REVER  FALSE */
-	static const uint32_t crcTable[256] = {
-			0x00000000L, 0x04C11DB7L, 0x09823B6EL, 0x0D4326D9L,
-			0x130476DCL, 0x17C56B6BL, 0x1A864DB2L, 0x1E475005L,
-			0x2608EDB8L, 0x22C9F00FL, 0x2F8AD6D6L, 0x2B4BCB61L,
-			0x350C9B64L, 0x31CD86D3L, 0x3C8EA00AL, 0x384FBDBDL,
-			0x4C11DB70L, 0x48D0C6C7L, 0x4593E01EL, 0x4152FDA9L,
-			0x5F15ADACL, 0x5BD4B01BL, 0x569796C2L, 0x52568B75L,
-			0x6A1936C8L, 0x6ED82B7FL, 0x639B0DA6L, 0x675A1011L,
-			0x791D4014L, 0x7DDC5DA3L, 0x709F7B7AL, 0x745E66CDL,
-			0x9823B6E0L, 0x9CE2AB57L, 0x91A18D8EL, 0x95609039L,
-			0x8B27C03CL, 0x8FE6DD8BL, 0x82A5FB52L, 0x8664E6E5L,
-			0xBE2B5B58L, 0xBAEA46EFL, 0xB7A96036L, 0xB3687D81L,
-			0xAD2F2D84L, 0xA9EE3033L, 0xA4AD16EAL, 0xA06C0B5DL,
-			0xD4326D90L, 0xD0F37027L, 0xDDB056FEL, 0xD9714B49L,
-			0xC7361B4CL, 0xC3F706FBL, 0xCEB42022L, 0xCA753D95L,
-			0xF23A8028L, 0xF6FB9D9FL, 0xFBB8BB46L, 0xFF79A6F1L,
-			0xE13EF6F4L, 0xE5FFEB43L, 0xE8BCCD9AL, 0xEC7DD02DL,
-			0x34867077L, 0x30476DC0L, 0x3D044B19L, 0x39C556AEL,
-			0x278206ABL, 0x23431B1CL, 0x2E003DC5L, 0x2AC12072L,
-			0x128E9DCFL, 0x164F8078L, 0x1B0CA6A1L, 0x1FCDBB16L,
-			0x018AEB13L, 0x054BF6A4L, 0x0808D07DL, 0x0CC9CDCAL,
-			0x7897AB07L, 0x7C56B6B0L, 0x71159069L, 0x75D48DDEL,
-			0x6B93DDDBL, 0x6F52C06CL, 0x6211E6B5L, 0x66D0FB02L,
-			0x5E9F46BFL, 0x5A5E5B08L, 0x571D7DD1L, 0x53DC6066L,
-			0x4D9B3063L, 0x495A2DD4L, 0x44190B0DL, 0x40D816BAL,
-			0xACA5C697L, 0xA864DB20L, 0xA527FDF9L, 0xA1E6E04EL,
-			0xBFA1B04BL, 0xBB60ADFCL, 0xB6238B25L, 0xB2E29692L,
-			0x8AAD2B2FL, 0x8E6C3698L, 0x832F1041L, 0x87EE0DF6L,
-			0x99A95DF3L, 0x9D684044L, 0x902B669DL, 0x94EA7B2AL,
-			0xE0B41DE7L, 0xE4750050L, 0xE9362689L, 0xEDF73B3EL,
-			0xF3B06B3BL, 0xF771768CL, 0xFA325055L, 0xFEF34DE2L,
-			0xC6BCF05FL, 0xC27DEDE8L, 0xCF3ECB31L, 0xCBFFD686L,
-			0xD5B88683L, 0xD1799B34L, 0xDC3ABDEDL, 0xD8FBA05AL,
-			0x690CE0EEL, 0x6DCDFD59L, 0x608EDB80L, 0x644FC637L,
-			0x7A089632L, 0x7EC98B85L, 0x738AAD5CL, 0x774BB0EBL,
-			0x4F040D56L, 0x4BC510E1L, 0x46863638L, 0x42472B8FL,
-			0x5C007B8AL, 0x58C1663DL, 0x558240E4L, 0x51435D53L,
-			0x251D3B9EL, 0x21DC2629L, 0x2C9F00F0L, 0x285E1D47L,
-			0x36194D42L, 0x32D850F5L, 0x3F9B762CL, 0x3B5A6B9BL,
-			0x0315D626L, 0x07D4CB91L, 0x0A97ED48L, 0x0E56F0FFL,
-			0x1011A0FAL, 0x14D0BD4DL, 0x19939B94L, 0x1D528623L,
-			0xF12F560EL, 0xF5EE4BB9L, 0xF8AD6D60L, 0xFC6C70D7L,
-			0xE22B20D2L, 0xE6EA3D65L, 0xEBA91BBCL, 0xEF68060BL,
-			0xD727BBB6L, 0xD3E6A601L, 0xDEA580D8L, 0xDA649D6FL,
-			0xC423CD6AL, 0xC0E2D0DDL, 0xCDA1F604L, 0xC960EBB3L,
-			0xBD3E8D7EL, 0xB9FF90C9L, 0xB4BCB610L, 0xB07DABA7L,
-			0xAE3AFBA2L, 0xAAFBE615L, 0xA7B8C0CCL, 0xA379DD7BL,
-			0x9B3660C6L, 0x9FF77D71L, 0x92B45BA8L, 0x9675461FL,
-			0x8832161AL, 0x8CF30BADL, 0x81B02D74L, 0x857130C3L,
-			0x5D8A9099L, 0x594B8D2EL, 0x5408ABF7L, 0x50C9B640L,
-			0x4E8EE645L, 0x4A4FFBF2L, 0x470CDD2BL, 0x43CDC09CL,
-			0x7B827D21L, 0x7F436096L, 0x7200464FL, 0x76C15BF8L,
-			0x68860BFDL, 0x6C47164AL, 0x61043093L, 0x65C52D24L,
-			0x119B4BE9L, 0x155A565EL, 0x18197087L, 0x1CD86D30L,
-			0x029F3D35L, 0x065E2082L, 0x0B1D065BL, 0x0FDC1BECL,
-			0x3793A651L, 0x3352BBE6L, 0x3E119D3FL, 0x3AD08088L,
-			0x2497D08DL, 0x2056CD3AL, 0x2D15EBE3L, 0x29D4F654L,
-			0xC5A92679L, 0xC1683BCEL, 0xCC2B1D17L, 0xC8EA00A0L,
-			0xD6AD50A5L, 0xD26C4D12L, 0xDF2F6BCBL, 0xDBEE767CL,
-			0xE3A1CBC1L, 0xE760D676L, 0xEA23F0AFL, 0xEEE2ED18L,
-			0xF0A5BD1DL, 0xF464A0AAL, 0xF9278673L, 0xFDE69BC4L,
-			0x89B8FD09L, 0x8D79E0BEL, 0x803AC667L, 0x84FBDBD0L,
-			0x9ABC8BD5L, 0x9E7D9662L, 0x933EB0BBL, 0x97FFAD0CL,
-			0xAFB010B1L, 0xAB710D06L, 0xA6322BDFL, 0xA2F33668L,
-			0xBCB4666DL, 0xB8757BDAL, 0xB5365D03L, 0xB1F740B4L
-	};
+/* using #define TB_POLY   0x04C11DB7L, #define TB_REVER  FALSE */
+const uint32_t crc32Table[256] = {
+	0x00000000L, 0x04C11DB7L, 0x09823B6EL, 0x0D4326D9L,
+	0x130476DCL, 0x17C56B6BL, 0x1A864DB2L, 0x1E475005L,
+	0x2608EDB8L, 0x22C9F00FL, 0x2F8AD6D6L, 0x2B4BCB61L,
+	0x350C9B64L, 0x31CD86D3L, 0x3C8EA00AL, 0x384FBDBDL,
+	0x4C11DB70L, 0x48D0C6C7L, 0x4593E01EL, 0x4152FDA9L,
+	0x5F15ADACL, 0x5BD4B01BL, 0x569796C2L, 0x52568B75L,
+	0x6A1936C8L, 0x6ED82B7FL, 0x639B0DA6L, 0x675A1011L,
+	0x791D4014L, 0x7DDC5DA3L, 0x709F7B7AL, 0x745E66CDL,
+	0x9823B6E0L, 0x9CE2AB57L, 0x91A18D8EL, 0x95609039L,
+	0x8B27C03CL, 0x8FE6DD8BL, 0x82A5FB52L, 0x8664E6E5L,
+	0xBE2B5B58L, 0xBAEA46EFL, 0xB7A96036L, 0xB3687D81L,
+	0xAD2F2D84L, 0xA9EE3033L, 0xA4AD16EAL, 0xA06C0B5DL,
+	0xD4326D90L, 0xD0F37027L, 0xDDB056FEL, 0xD9714B49L,
+	0xC7361B4CL, 0xC3F706FBL, 0xCEB42022L, 0xCA753D95L,
+	0xF23A8028L, 0xF6FB9D9FL, 0xFBB8BB46L, 0xFF79A6F1L,
+	0xE13EF6F4L, 0xE5FFEB43L, 0xE8BCCD9AL, 0xEC7DD02DL,
+	0x34867077L, 0x30476DC0L, 0x3D044B19L, 0x39C556AEL,
+	0x278206ABL, 0x23431B1CL, 0x2E003DC5L, 0x2AC12072L,
+	0x128E9DCFL, 0x164F8078L, 0x1B0CA6A1L, 0x1FCDBB16L,
+	0x018AEB13L, 0x054BF6A4L, 0x0808D07DL, 0x0CC9CDCAL,
+	0x7897AB07L, 0x7C56B6B0L, 0x71159069L, 0x75D48DDEL,
+	0x6B93DDDBL, 0x6F52C06CL, 0x6211E6B5L, 0x66D0FB02L,
+	0x5E9F46BFL, 0x5A5E5B08L, 0x571D7DD1L, 0x53DC6066L,
+	0x4D9B3063L, 0x495A2DD4L, 0x44190B0DL, 0x40D816BAL,
+	0xACA5C697L, 0xA864DB20L, 0xA527FDF9L, 0xA1E6E04EL,
+	0xBFA1B04BL, 0xBB60ADFCL, 0xB6238B25L, 0xB2E29692L,
+	0x8AAD2B2FL, 0x8E6C3698L, 0x832F1041L, 0x87EE0DF6L,
+	0x99A95DF3L, 0x9D684044L, 0x902B669DL, 0x94EA7B2AL,
+	0xE0B41DE7L, 0xE4750050L, 0xE9362689L, 0xEDF73B3EL,
+	0xF3B06B3BL, 0xF771768CL, 0xFA325055L, 0xFEF34DE2L,
+	0xC6BCF05FL, 0xC27DEDE8L, 0xCF3ECB31L, 0xCBFFD686L,
+	0xD5B88683L, 0xD1799B34L, 0xDC3ABDEDL, 0xD8FBA05AL,
+	0x690CE0EEL, 0x6DCDFD59L, 0x608EDB80L, 0x644FC637L,
+	0x7A089632L, 0x7EC98B85L, 0x738AAD5CL, 0x774BB0EBL,
+	0x4F040D56L, 0x4BC510E1L, 0x46863638L, 0x42472B8FL,
+	0x5C007B8AL, 0x58C1663DL, 0x558240E4L, 0x51435D53L,
+	0x251D3B9EL, 0x21DC2629L, 0x2C9F00F0L, 0x285E1D47L,
+	0x36194D42L, 0x32D850F5L, 0x3F9B762CL, 0x3B5A6B9BL,
+	0x0315D626L, 0x07D4CB91L, 0x0A97ED48L, 0x0E56F0FFL,
+	0x1011A0FAL, 0x14D0BD4DL, 0x19939B94L, 0x1D528623L,
+	0xF12F560EL, 0xF5EE4BB9L, 0xF8AD6D60L, 0xFC6C70D7L,
+	0xE22B20D2L, 0xE6EA3D65L, 0xEBA91BBCL, 0xEF68060BL,
+	0xD727BBB6L, 0xD3E6A601L, 0xDEA580D8L, 0xDA649D6FL,
+	0xC423CD6AL, 0xC0E2D0DDL, 0xCDA1F604L, 0xC960EBB3L,
+	0xBD3E8D7EL, 0xB9FF90C9L, 0xB4BCB610L, 0xB07DABA7L,
+	0xAE3AFBA2L, 0xAAFBE615L, 0xA7B8C0CCL, 0xA379DD7BL,
+	0x9B3660C6L, 0x9FF77D71L, 0x92B45BA8L, 0x9675461FL,
+	0x8832161AL, 0x8CF30BADL, 0x81B02D74L, 0x857130C3L,
+	0x5D8A9099L, 0x594B8D2EL, 0x5408ABF7L, 0x50C9B640L,
+	0x4E8EE645L, 0x4A4FFBF2L, 0x470CDD2BL, 0x43CDC09CL,
+	0x7B827D21L, 0x7F436096L, 0x7200464FL, 0x76C15BF8L,
+	0x68860BFDL, 0x6C47164AL, 0x61043093L, 0x65C52D24L,
+	0x119B4BE9L, 0x155A565EL, 0x18197087L, 0x1CD86D30L,
+	0x029F3D35L, 0x065E2082L, 0x0B1D065BL, 0x0FDC1BECL,
+	0x3793A651L, 0x3352BBE6L, 0x3E119D3FL, 0x3AD08088L,
+	0x2497D08DL, 0x2056CD3AL, 0x2D15EBE3L, 0x29D4F654L,
+	0xC5A92679L, 0xC1683BCEL, 0xCC2B1D17L, 0xC8EA00A0L,
+	0xD6AD50A5L, 0xD26C4D12L, 0xDF2F6BCBL, 0xDBEE767CL,
+	0xE3A1CBC1L, 0xE760D676L, 0xEA23F0AFL, 0xEEE2ED18L,
+	0xF0A5BD1DL, 0xF464A0AAL, 0xF9278673L, 0xFDE69BC4L,
+	0x89B8FD09L, 0x8D79E0BEL, 0x803AC667L, 0x84FBDBD0L,
+	0x9ABC8BD5L, 0x9E7D9662L, 0x933EB0BBL, 0x97FFAD0CL,
+	0xAFB010B1L, 0xAB710D06L, 0xA6322BDFL, 0xA2F33668L,
+	0xBCB4666DL, 0xB8757BDAL, 0xB5365D03L, 0xB1F740B4L
+};
 
+_unused_ static uint32_t crc32 (uint32_t inCrc32, const void *buf, size_t bufLen) {
     uint32_t crc32;
     uint8_t *byteBuf;
     size_t i;
@@ -144,7 +145,7 @@ _unused_ static uint32_t crc32 (uint32_t inCrc32, const void *buf, size_t bufLen
     crc32 = 0;
     byteBuf = (uint8_t *) buf;
     for (i=0; i < bufLen; i++) {
-        crc32 = (crc32 >> 8) ^ crcTable[ (crc32 ^ byteBuf[i]) & 0xFF ];
+        crc32 = (crc32 >> 8) ^ crc32Table[ (crc32 ^ byteBuf[i]) & 0xFF ];
     }
 	/* XXX: dito */
     //return( crc32 ^ 0xFFFFFFFF );
@@ -155,39 +156,318 @@ _unused_ static uint32_t crc32 (uint32_t inCrc32, const void *buf, size_t bufLen
  *  END OF MODULE: crc32.c
 \*----------------------------------------------------------------------------*/
 
+/*	The table above is linear, T[a^b] = T[a]^T[b], which allows other
+ *	tables to compute the same crc. All variants must produce the same
+ *	result as crc32 (), since the correction syndromes depend on it.
+ */
+
+uint32_t crc32Bytewise (const void * const buf, const size_t len) {
+	return crc32 (0, buf, len);
+}
+
+/*	Small variant, two 16 entry tables for the low and high nibble of the table
+ *	index: T[i] = T[i&0xf] ^ T[i&0xf0]
+ */
+static const uint32_t crcTableLo[16] = {
+		0x00000000L, 0x04C11DB7L, 0x09823B6EL, 0x0D4326D9L,
+		0x130476DCL, 0x17C56B6BL, 0x1A864DB2L, 0x1E475005L,
+		0x2608EDB8L, 0x22C9F00FL, 0x2F8AD6D6L, 0x2B4BCB61L,
+		0x350C9B64L, 0x31CD86D3L, 0x3C8EA00AL, 0x384FBDBDL,
+		};
+static const uint32_t crcTableHi[16] = {
+		0x00000000L, 0x4C11DB70L, 0x9823B6E0L, 0xD4326D90L,
+		0x34867077L, 0x7897AB07L, 0xACA5C697L, 0xE0B41DE7L,
+		0x690CE0EEL, 0x251D3B9EL, 0xF12F560EL, 0xBD3E8D7EL,
+		0x5D8A9099L, 0x119B4BE9L, 0xC5A92679L, 0x89B8FD09L,
+		};
+
+uint32_t crc32Nibble (const void * const buf, const size_t len) {
+	const uint8_t * const b = buf;
+	uint32_t crc = 0;
+	for (size_t i = 0; i < len; i++) {
+		const uint8_t x = crc ^ b[i];
+		crc = (crc >> 8) ^ crcTableLo[x & 0xf] ^ crcTableHi[x >> 4];
+	}
+	return crc;
+}
+
+/*	Slicing tables, T_k[i] = T_{k-1}[i]>>8 ^ T[T_{k-1}[i]&0xff] is the crc of
+ *	byte i followed by k zero bytes, so four/eight bytes can be processed with
+ *	independent lookups. 8 KiB of RAM, which is faster than flash with wait
+ *	states.
+ */
+static uint32_t crcSliceTable[8][256];
+
+void crc32SliceInit (void) {
+	for (unsigned int i = 0; i < 256; i++) {
+		crcSliceTable[0][i] = crc32Table[i];
+	}
+	for (unsigned int k = 1; k < 8; k++) {
+		for (unsigned int i = 0; i < 256; i++) {
+			const uint32_t v = crcSliceTable[k-1][i];
+			crcSliceTable[k][i] = (v >> 8) ^ crc32Table[v & 0xff];
+		}
+	}
+}
+
+/*	Process bytes until b is word-aligned
+ */
+static uint32_t crc32Align (uint32_t crc, const uint8_t ** const b,
+		size_t * const len) {
+	while (*len > 0 && ((uintptr_t) *b & 3) != 0) {
+		crc = (crc >> 8) ^ crc32Table[(crc ^ **b) & 0xff];
+		++*b;
+		--*len;
+	}
+	return crc;
+}
+
+/*	Aligned word load, memcpy keeps it free of aliasing issues
+ */
+static uint32_t load32 (const uint8_t * const b) {
+	uint32_t v;
+	memcpy (&v, b, sizeof (v));
+	return v;
+}
+
+static uint32_t crc32Tail (uint32_t crc, const uint8_t *b, size_t len) {
+	while (len > 0) {
+		crc = (crc >> 8) ^ crc32Table[(crc ^ *b) & 0xff];
+		++b;
+		--len;
+	}
+	return crc;
+}
+
+/* little endian only, first byte in the lowest bits */
+uint32_t crc32Slice4 (const void * const buf, size_t len) {
+	const uint8_t *b = buf;
+	uint32_t crc = crc32Align (0, &b, &len);
+	const uint32_t (* const t)[256] = crcSliceTable;
+
+	for (; len >= 4; len -= 4, b += 4) {
+		crc ^= load32 (b);
+		crc = t[3][crc & 0xff] ^ t[2][(crc >> 8) & 0xff] ^
+				t[1][(crc >> 16) & 0xff] ^ t[0][crc >> 24];
+	}
+	return crc32Tail (crc, b, len);
+}
+
+uint32_t crc32Slice8 (const void * const buf, size_t len) {
+	const uint8_t *b = buf;
+	uint32_t crc = crc32Align (0, &b, &len);
+	const uint32_t (* const t)[256] = crcSliceTable;
+
+	for (; len >= 8; len -= 8, b += 8) {
+		const uint32_t lo = crc ^ load32 (b);
+		const uint32_t hi = load32 (b+4);
+		crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^
+				t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+				t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^
+				t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+	}
+	return crc32Tail (crc, b, len);
+}
+
 uint32_t crc32Calc (const uint32_t * const data, const size_t len) {
-	return crc32 (0, data, len);
+#if CRC32_IMPL == CRC32_SLICE8
+	return crc32Slice8 (data, len);
+#elif CRC32_IMPL == CRC32_SLICE4
+	return crc32Slice4 (data, len);
+#elif CRC32_IMPL == CRC32_NIBBLE
+	return crc32Nibble (data, len);
+#else
+	return crc32Bytewise (data, len);
+#endif
 }
 
-/* map crc32 remainder to 1 bit error position */
-static uint32_t crc32CorrectionTable[256];
+/*	Syndromes of all single bit errors, sorted for bisection, and the bit
+ *	positions they belong to
+ */
+static uint32_t crc32Syndrome[CRC32_MAX_MSGLEN*8];
+static uint16_t crc32SyndromeBit[CRC32_MAX_MSGLEN*8];
 static uint32_t tblLen = 0;
+#if CRC32_CORRECT_BURST > 0
+/* crc32Table index by top byte of its entry, inverts crc32Zero */
+static uint8_t crc32TopInverse[256];
+#endif
 
-/*	msgLen includes trailing crc32 */
+crc32Stats crc32Statistics;
+
+/*	crc after appending a zero byte
+ */
+static uint32_t crc32Zero (const uint32_t crc) {
+	return (crc >> 8) ^ crc32Table[crc & 0xff];
+}
+
+#if CRC32_CORRECT_BURST > 0
+/*	Inverse of crc32Zero. The top bytes of all table entries are distinct,
+ *	so the top byte of the result identifies the table index.
+ */
+static uint32_t crc32ZeroInverse (const uint32_t crc) {
+	const uint8_t x = crc32TopInverse[crc >> 24];
+	return ((crc ^ crc32Table[x]) << 8) | x;
+}
+#endif
+
+/*	Shell sort both tables by syndrome, no allocation required
+ */
+static void sortSyndromes (const size_t n) {
+	static const uint16_t gaps[] = {701, 301, 132, 57, 23, 10, 4, 1};
+	for (size_t g = 0; g < arraysize (gaps); g++) {
+		const size_t gap = gaps[g];
+		for (size_t i = gap; i < n; i++) {
+			const uint32_t s = crc32Syndrome[i];
+			const uint16_t b = crc32SyndromeBit[i];
+			size_t j = i;
+			for (; j >= gap && crc32Syndrome[j-gap] > s; j -= gap) {
+				crc32Syndrome[j] = crc32Syndrome[j-gap];
+				crc32SyndromeBit[j] = crc32SyndromeBit[j-gap];
+			}
+			crc32Syndrome[j] = s;
+			crc32SyndromeBit[j] = b;
+		}
+	}
+}
+
+/*	msgLen is the longest message including trailing crc32. Shorter messages
+ *	can be corrected too, since leading zeros do not change the crc.
+ */
 void crc32Init (const unsigned int msgLen) {
+#if CRC32_IMPL == CRC32_SLICE4 || CRC32_IMPL == CRC32_SLICE8
+	crc32SliceInit ();
+#endif
 	/* init correction table */
 	const size_t tableLen = msgLen*8;
-	assert (tableLen <= sizeof (crc32CorrectionTable)/sizeof (*crc32CorrectionTable));
-	const size_t bufLen = msgLen;
-	uint8_t *buf = malloc (bufLen);
-	for (unsigned int i = 0; i < msgLen; i++) {
+	assert (tableLen <= arraysize (crc32Syndrome));
+	/* the crc is linear, so the syndrome of bit j in byte i is the crc of byte
+	 * 1<<j followed by msgLen-1-i zero bytes. Walk backwards from the last
+	 * byte, appending one zero byte per step. */
+	uint32_t s[8];
+	for (unsigned int j = 0; j < 8; j++) {
+		s[j] = crc32Table[1<<j];
+	}
+	for (unsigned int i = msgLen; i-- > 0; ) {
 		for (unsigned int j = 0; j < 8; j++) {
-			memset (buf, 0, bufLen);
-			buf[i] = 1<<j;
-			const uint32_t v = crc32Calc ((void *) buf, bufLen);
-			crc32CorrectionTable[i*8+j] = v;
+			crc32Syndrome[i*8+j] = s[j];
+			crc32SyndromeBit[i*8+j] = i*8+j;
+			s[j] = crc32Zero (s[j]);
+		}
+	}
+	sortSyndromes (tableLen);
+	tblLen = tableLen;
+
+#if CRC32_CORRECT_BURST > 0
+	for (unsigned int i = 0; i < 256; i++) {
+		crc32TopInverse[crc32Table[i] >> 24] = i;
+	}
+#endif
+}
+
+/*	Find incorrect bit in message of msgLen bytes (including crc), bisection
+ *	takes at most log2(CRC32_MAX_MSGLEN*8) steps
+ */
+unsigned int crc32IncorrectBit (const uint32_t crc, const unsigned int msgLen) {
+	assert (msgLen*8 <= tblLen);
+	size_t lo = 0, hi = tblLen;
+	while (lo < hi) {
+		const size_t mid = (lo+hi)/2;
+		if (crc32Syndrome[mid] < crc) {
+			lo = mid+1;
+		} else {
+			hi = mid;
 		}
 	}
-	tblLen = bufLen*8;
-	free (buf);
+	if (lo == tblLen || crc32Syndrome[lo] != crc) {
+		return -1;
+	}
+	/* the message is aligned to the end of the table */
+	const unsigned int offset = tblLen - msgLen*8;
+	const unsigned int bit = crc32SyndromeBit[lo];
+	if (bit < offset) {
+		return -1;
+	}
+	return bit - offset;
 }
 
-unsigned int crc32IncorrectBit (const uint32_t crc) {
-	/* XXX: use bisect? */
-	for (unsigned int i = 0; i < tblLen; i++) {
-		if (crc == crc32CorrectionTable[i]) {
-			return i;
+/*	Find an error burst of at most CRC32_CORRECT_BURST bits. The syndrome of
+ *	any error within the four bytes starting at byte i is the crc of these
+ *	bytes (as little endian word W) followed by zeros, i.e. W with
+ *	msgLen-i zero bytes appended. Removing zero bytes one by one yields W
+ *	for every window, starting at the end of the message.
+ */
+static bool correctBurst (uint8_t * const buf, const unsigned int msgLen,
+		const uint32_t crc) {
+#if CRC32_CORRECT_BURST > 0
+	uint32_t w = crc;
+	for (unsigned int i = 0; i < 4; i++) {
+		w = crc32ZeroInverse (w);
+	}
+	for (unsigned int i = msgLen-4; ; i--) {
+		if (w != 0) {
+			const unsigned int span = 32 - __builtin_clz (w) - __builtin_ctz (w);
+			if (span <= CRC32_CORRECT_BURST) {
+				for (unsigned int j = 0; j < 4; j++) {
+					buf[i+j] ^= w >> (j*8);
+				}
+				return true;
+			}
 		}
+		if (i == 0) {
+			break;
+		}
+		w = crc32ZeroInverse (w);
+	}
+#endif
+	return false;
+}
+
+/*	Find two incorrect bits a and b with S[a]^S[b] = crc by looking up
+ *	crc^S[a] for every a, at most msgLen*8 bisections.
+ */
+static bool correctTwoBit (uint8_t * const buf, const unsigned int msgLen,
+		const uint32_t crc) {
+#ifdef CRC32_CORRECT_TWOBIT
+	const unsigned int offset = tblLen - msgLen*8;
+	for (size_t k = 0; k < tblLen; k++) {
+		const unsigned int a = crc32SyndromeBit[k];
+		if (a < offset) {
+			continue;
+		}
+		const unsigned int b = crc32IncorrectBit (crc ^ crc32Syndrome[k], msgLen);
+		if (b != -1 && b > a - offset) {
+			buf[(a-offset)/8] ^= 1<<((a-offset)%8);
+			buf[b/8] ^= 1<<(b%8);
+			return true;
+		}
+	}
+#endif
+	return false;
+}
+
+/*	Correct buf of msgLen bytes (including crc) with crc remainder crc. Tries
+ *	single bit errors, bursts and two bit errors, which can all be told apart
+ *	for CRC32_MAX_MSGLEN with bursts up to 6 bits (10 bits without two bit
+ *	correction). Every pattern corrected also turns a fraction of heavily
+ *	corrupted packets into wrong ones: about 1 in 25000 with both enabled,
+ *	so they are off by default, see config.h.
+ */
+crc32Correction crc32Correct (uint8_t * const buf, const unsigned int msgLen,
+		const uint32_t crc) {
+	assert (msgLen >= 4);
+	const unsigned int incorrect = crc32IncorrectBit (crc, msgLen);
+	if (incorrect != -1) {
+		buf[incorrect/8] ^= (1<<(incorrect%8));
+		++crc32Statistics.oneBit;
+		return CRC32_CORRECTED_ONEBIT;
+	}
+	if (correctBurst (buf, msgLen, crc)) {
+		++crc32Statistics.burst;
+		return CRC32_CORRECTED_BURST;
+	}
+	if (correctTwoBit (buf, msgLen, crc)) {
+		++crc32Statistics.twoBit;
+		return CRC32_CORRECTED_TWOBIT;
 	}
-	return -1;
+	return CRC32_UNCORRECTABLE;
 }
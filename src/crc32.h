@@ -22,9 +22,51 @@ THE SOFTWARE.
 
 #pragma once
 
+/* longest message that can be corrected, including crc */
+#define CRC32_MAX_MSGLEN (68)
+
+/* crc32 implementations, see CRC32_IMPL in config.h */
+#define CRC32_BYTEWISE (0)
+/* two 16 entry tables instead of one with 256 entries */
+#define CRC32_NIBBLE (1)
+#define CRC32_SLICE4 (2)
+#define CRC32_SLICE8 (3)
+
 /* crc32 calculation, either using a hardware accelerator found in xmc4500 or a
  * public domain c implementation */
 uint32_t crc32Calc (const uint32_t * const data, const size_t len);
-unsigned int crc32IncorrectBit (const uint32_t crc);
+/* individual implementations, slicing requires crc32SliceInit */
+uint32_t crc32Bytewise (const void * const buf, const size_t len);
+uint32_t crc32Nibble (const void * const buf, const size_t len);
+uint32_t crc32Slice4 (const void * const buf, size_t len);
+uint32_t crc32Slice8 (const void * const buf, size_t len);
+void crc32SliceInit (void);
+
+extern const uint32_t crc32Table[256];
+
+/*	Bytewise crc32 step, for code that touches every byte anyway. Same result
+ *	as crc32Calc when starting with zero.
+ */
+static inline uint32_t crc32Byte (const uint32_t crc, const uint8_t b) {
+	return (crc >> 8) ^ crc32Table[(crc ^ b) & 0xff];
+}
+unsigned int crc32IncorrectBit (const uint32_t crc, const unsigned int msgLen);
+
+typedef enum {
+	CRC32_UNCORRECTABLE,
+	CRC32_CORRECTED_ONEBIT,
+	CRC32_CORRECTED_BURST,
+	CRC32_CORRECTED_TWOBIT,
+} crc32Correction;
+
+/* packets corrected, by method */
+typedef struct {
+	uint32_t oneBit, burst, twoBit;
+} crc32Stats;
+
+extern crc32Stats crc32Statistics;
+
+crc32Correction crc32Correct (uint8_t * const buf, const unsigned int msgLen,
+		const uint32_t crc);
 void crc32Init (const unsigned int msgLen);
 
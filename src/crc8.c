@@ -0,0 +1,128 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#include <assert.h>
+#include <string.h>
+
+#include "util.h"
+#include "crc8.h"
+
+/* polynomial 0x1d reflected, no initial value or final xor. The polynomial is
+ * primitive, so all single bit errors in up to 255 bits have distinct
+ * syndromes. */
+const uint8_t crc8Table[256] = {
+	0x00, 0x64, 0xc8, 0xac, 0xe1, 0x85, 0x29, 0x4d,
+	0xb3, 0xd7, 0x7b, 0x1f, 0x52, 0x36, 0x9a, 0xfe,
+	0x17, 0x73, 0xdf, 0xbb, 0xf6, 0x92, 0x3e, 0x5a,
+	0xa4, 0xc0, 0x6c, 0x08, 0x45, 0x21, 0x8d, 0xe9,
+	0x2e, 0x4a, 0xe6, 0x82, 0xcf, 0xab, 0x07, 0x63,
+	0x9d, 0xf9, 0x55, 0x31, 0x7c, 0x18, 0xb4, 0xd0,
+	0x39, 0x5d, 0xf1, 0x95, 0xd8, 0xbc, 0x10, 0x74,
+	0x8a, 0xee, 0x42, 0x26, 0x6b, 0x0f, 0xa3, 0xc7,
+	0x5c, 0x38, 0x94, 0xf0, 0xbd, 0xd9, 0x75, 0x11,
+	0xef, 0x8b, 0x27, 0x43, 0x0e, 0x6a, 0xc6, 0xa2,
+	0x4b, 0x2f, 0x83, 0xe7, 0xaa, 0xce, 0x62, 0x06,
+	0xf8, 0x9c, 0x30, 0x54, 0x19, 0x7d, 0xd1, 0xb5,
+	0x72, 0x16, 0xba, 0xde, 0x93, 0xf7, 0x5b, 0x3f,
+	0xc1, 0xa5, 0x09, 0x6d, 0x20, 0x44, 0xe8, 0x8c,
+	0x65, 0x01, 0xad, 0xc9, 0x84, 0xe0, 0x4c, 0x28,
+	0xd6, 0xb2, 0x1e, 0x7a, 0x37, 0x53, 0xff, 0x9b,
+	0xb8, 0xdc, 0x70, 0x14, 0x59, 0x3d, 0x91, 0xf5,
+	0x0b, 0x6f, 0xc3, 0xa7, 0xea, 0x8e, 0x22, 0x46,
+	0xaf, 0xcb, 0x67, 0x03, 0x4e, 0x2a, 0x86, 0xe2,
+	0x1c, 0x78, 0xd4, 0xb0, 0xfd, 0x99, 0x35, 0x51,
+	0x96, 0xf2, 0x5e, 0x3a, 0x77, 0x13, 0xbf, 0xdb,
+	0x25, 0x41, 0xed, 0x89, 0xc4, 0xa0, 0x0c, 0x68,
+	0x81, 0xe5, 0x49, 0x2d, 0x60, 0x04, 0xa8, 0xcc,
+	0x32, 0x56, 0xfa, 0x9e, 0xd3, 0xb7, 0x1b, 0x7f,
+	0xe4, 0x80, 0x2c, 0x48, 0x05, 0x61, 0xcd, 0xa9,
+	0x57, 0x33, 0x9f, 0xfb, 0xb6, 0xd2, 0x7e, 0x1a,
+	0xf3, 0x97, 0x3b, 0x5f, 0x12, 0x76, 0xda, 0xbe,
+	0x40, 0x24, 0x88, 0xec, 0xa1, 0xc5, 0x69, 0x0d,
+	0xca, 0xae, 0x02, 0x66, 0x2b, 0x4f, 0xe3, 0x87,
+	0x79, 0x1d, 0xb1, 0xd5, 0x98, 0xfc, 0x50, 0x34,
+	0xdd, 0xb9, 0x15, 0x71, 0x3c, 0x58, 0xf4, 0x90,
+	0x6e, 0x0a, 0xa6, 0xc2, 0x8f, 0xeb, 0x47, 0x23,
+	};
+
+uint8_t crc8Calc (const void * const buf, const size_t len) {
+	const uint8_t *b = buf;
+	uint8_t crc = 0;
+	for (size_t i = 0; i < len; i++) {
+		crc = crc8Byte (crc, b[i]);
+	}
+	return crc;
+}
+
+/* bit position by syndrome, bytes counted from the end of the message, 0xff
+ * if none */
+static uint8_t crc8SyndromeBit[256];
+static unsigned int tblLen = 0;
+
+/*	msgLen is the longest message including trailing crc8, see crc32Init
+ */
+void crc8Init (const unsigned int msgLen) {
+	assert (msgLen <= CRC8_MAX_MSGLEN);
+	memset (crc8SyndromeBit, 0xff, sizeof (crc8SyndromeBit));
+	uint8_t s[8];
+	for (unsigned int j = 0; j < 8; j++) {
+		s[j] = crc8Table[1<<j];
+	}
+	for (unsigned int i = 0; i < msgLen; i++) {
+		for (unsigned int j = 0; j < 8; j++) {
+			crc8SyndromeBit[s[j]] = i*8+j;
+			s[j] = crc8Byte (s[j], 0);
+		}
+	}
+	tblLen = msgLen*8;
+}
+
+/*	Find incorrect bit in message of msgLen bytes (including crc), a single
+ *	table lookup
+ */
+unsigned int crc8IncorrectBit (const uint8_t crc, const unsigned int msgLen) {
+	assert (msgLen*8 <= tblLen);
+	const unsigned int bit = crc8SyndromeBit[crc];
+	if (bit >= msgLen*8) {
+		return -1;
+	}
+	return (msgLen-1-bit/8)*8 + bit%8;
+}
+
+/*	Correct a single bit error in buf of msgLen bytes (including crc). Most
+ *	syndromes belong to some bit of a long message, so this also turns many
+ *	heavily corrupted packets into wrong ones.
+ */
+bool crc8Correct (uint8_t * const buf, const unsigned int msgLen,
+		const uint8_t crc) {
+	assert (msgLen >= 1);
+	if (msgLen > CRC8_MAX_MSGLEN) {
+		return false;
+	}
+	const unsigned int incorrect = crc8IncorrectBit (crc, msgLen);
+	if (incorrect == -1) {
+		return false;
+	}
+	buf[incorrect/8] ^= 1<<(incorrect%8);
+	return true;
+}
+
@@ -0,0 +1,46 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* longest message that can be corrected, including crc. The polynomial’s
+ * period is 255 bits, single bit errors in longer messages are ambiguous */
+#define CRC8_MAX_MSGLEN (31)
+
+extern const uint8_t crc8Table[256];
+
+/*	Bytewise crc8 step, same result as crc8Calc when starting with zero.
+ */
+static inline uint8_t crc8Byte (const uint8_t crc, const uint8_t b) {
+	return crc8Table[crc ^ b];
+}
+
+uint8_t crc8Calc (const void * const buf, const size_t len);
+unsigned int crc8IncorrectBit (const uint8_t crc, const unsigned int msgLen);
+bool crc8Correct (uint8_t * const buf, const unsigned int msgLen,
+		const uint8_t crc);
+void crc8Init (const unsigned int msgLen);
+
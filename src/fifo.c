@@ -82,6 +82,16 @@ void *fifoPop (fifo * const fifo) {
 	return ret;
 }
 
+/*	Return oldest item without removing it
+ */
+void *fifoPeek (const fifo * const fifo) {
+	if (fifo->read == fifo->write) {
+		/* fifo empty */
+		return NULL;
+	}
+	return fifo->read;
+}
+
 /*	Items currently in fifo
  */
 size_t fifoItems (const fifo * const fifo) {
@@ -120,11 +130,13 @@ START_TEST (testAll) {
 		}
 		fail_unless (fifoPushAlloc (&f) == NULL);
 		for (uint8_t i = 0; i < maxitems; i++) {
+			const uint8_t * const p = fifoPeek (&f);
 			const uint8_t * const v = fifoPop (&f);
-			fail_unless (v != NULL);
+			fail_unless (v != NULL && p == v);
 			fail_unless (memcmp (v, &i, sizeof (i)) == 0, "expected %u, got %u", i, *v);
 		}
 		fail_unless (fifoPop (&f) == NULL, "fifo should be empty now");
+		fail_unless (fifoPeek (&f) == NULL);
 	}
 } END_TEST
 
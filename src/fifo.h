@@ -15,5 +15,6 @@ void fifoInit (fifo * const fifo, void * const data, const size_t len,
 void *fifoPushAlloc (fifo * const fifo);
 void fifoPushCommit (fifo * const fifo);
 void *fifoPop (fifo * const fifo);
+void *fifoPeek (const fifo * const fifo);
 size_t fifoItems (const fifo * const fifo);
 
@@ -21,41 +21,28 @@ THE SOFTWARE.
 */
 
 #include <assert.h>
+#include <stdatomic.h>
 #include <stdlib.h>
-#include <xmc_ccu4.h>
 #include <xmc_scu.h>
 
 #include <8b10b.h>
 #include <bitbuffer.h>
 
-#include "crc32.h"
 #include "fmac.h"
+#include "kset.h"
+#include "ksettable.h"
 #include "util.h"
 #include "config.h"
 
-/* timer settings */
-#define SLICE_COMPARE_LOWER CCU40_CC40
-#define SLICE_COMPARE_LOWER_NO (0)
-#define SLICE_COMPARE_LOWER_SHADOW XMC_CCU4_SHADOW_TRANSFER_SLICE_0
-#define SLICE_COMPARE_UPPER CCU40_CC41
-#define SLICE_COMPARE_UPPER_NO (1)
-#define SLICE_COMPARE_UPPER_SHADOW XMC_CCU4_SHADOW_TRANSFER_SLICE_1
-#define MODULE_PTR        CCU40
-
 #if UC_SERIES == XMC11
-/* timer frequency, 8 MHz */
-#define TIMER_FREQ (4000000)
-#define PRESCALER XMC_CCU4_SLICE_PRESCALER_16
 #define CORRECTION_US (0)
 #elif UC_SERIES == XMC45
-/* timer frequency, 10 MHz */
-#define TIMER_FREQ (10000000)
-#define PRESCALER XMC_CCU4_SLICE_PRESCALER_8
 #define CORRECTION_US (0)
 #endif
-#define US_TO_TICKS(us) (us*(TIMER_FREQ/1000000))
 
 #define RXTX_SWITCHING_US (500)
+/* tda baud rate, see TDA_CFG_TXBAUDRATE */
+#define US_PER_BIT (10)
 #define DELTA_SCALER (1)
 
 #include <SEGGER_RTT.h>
@@ -68,9 +55,19 @@ THE SOFTWARE.
 /*	Go back to rx as soon as packet is sent
  */
 static void txempty (tda5340Ctx * const tda, void * const data) {
+	fmacCtx * const fm = data;
 	/* one-shot */
 	tda->txempty = NULL;
 	assert (tda->mode == TDA_TRANSMIT_MODE);
+
+	/* keep the framelet with the longest airtime per byte */
+	const uint32_t air = timerNow () - fm->calTxStart;
+	if (fm->calAirBytes == 0 ||
+			air*fm->calAirBytes > fm->calAir*fm->txPacketLen[fm->txCurrent]) {
+		fm->calAir = air;
+		fm->calAirBytes = fm->txPacketLen[fm->txCurrent];
+	}
+
 	/* go back to receiving after sending a packet */
 	while (!tda5340ModeSet (tda, TDA_RUN_MODE_SLAVE, false, TDA_CONFIG_B));
 }
@@ -81,8 +78,17 @@ static void txready (tda5340Ctx * const tda, void * const data) {
 	tda->txready = NULL;
 
 	assert (tda->mode == TDA_TRANSMIT_MODE);
+	fm->calTxStart = timerNow ();
+	if (fm->calPending) {
+		const uint32_t sw = fm->calTxStart - fm->calFlush;
+		if (sw > fm->calSwitch) {
+			fm->calSwitch = sw;
+		}
+		fm->calPending = false;
+	}
 	tda->txempty = txempty;
-	tda5340FifoWrite (tda, fm->txPacket, fm->frameletLen*8);
+	tda5340FifoWrite (tda, fm->txPacket[fm->txCurrent],
+			fm->txPacketLen[fm->txCurrent]*8);
 
 	TX_LED_FIRE;
 }
@@ -106,8 +112,11 @@ static bool flush (fmacCtx * const fm) {
 	 * sure why. */
 	if (tda->mode == TDA_TRANSMIT_MODE) {
 		SEGGER_RTT_printf (0, "flush: already in tx\n");
+		fm->calPending = false;
 		txready (tda, fm);
 	} else {
+		fm->calFlush = timerNow ();
+		fm->calPending = true;
 		if (!tda5340ModeSet (tda, TDA_TRANSMIT_MODE, false, TDA_CONFIG_A)) {
 			TX_LED_FIRE;
 			tda->txready = NULL;
@@ -117,114 +126,406 @@ static bool flush (fmacCtx * const fm) {
 	return true;
 }
 
-static void rxeom (tda5340Ctx * const tda, void * const data) {
-	fmacCtx * const fm = data;
-	assert (fm != NULL);
+/*	Is dest this station, one of its groups or broadcast?
+ */
+static bool addressed (const fmacCtx * const fm, const uint8_t dest) {
+	if (dest == FMAC_ADDR_BROADCAST) {
+		return true;
+	}
+	if (dest >= FMAC_ADDR_GROUP) {
+		const uint8_t g = dest - FMAC_ADDR_GROUP;
+		return g < FMAC_ADDR_GROUPS && (fm->groups & (UINT32_C(1) << g));
+	}
+	return dest == fm->i;
+}
 
-	RX_LED_FIRE;
+/*	Estimate the clock skew of src from a repetition received at time. Its
+ *	repetitions are k_src·δ of its own ticks apart, so the ticks counted here
+ *	since the first one differ by the skew. Our δ is used, so this assumes
+ *	all stations share it. Lost repetitions are skipped by
+ *	rounding to whole spacings, later ones span more of them and are weighted
+ *	higher. Repetitions are scheduled from the start of the sequence, so the
+ *	sender’s interrupt latency only adds jitter.
+ */
+static void skew (fmacCtx * const fm, const uint8_t src, const uint32_t time) {
+	const uint32_t span = time - fm->rxFirst[src];
+	const uint32_t spacing = fm->k[src]*fm->delta;
+	const uint32_t m = (span+spacing/2)/spacing;
+	if (m == 0 || m > fm->n-1) {
+		return;
+	}
+	/* in 1/16 ppm */
+	const int32_t sample = ((int64_t) m*spacing - (int64_t) span)*16000000/
+			(int64_t) span;
+	const uint32_t mask = UINT32_C(1)<<src;
+	if (fm->skewValid & mask) {
+		fm->skew[src] += (sample - fm->skew[src])*(int32_t) m/
+				(int32_t) (32*(fm->n-1));
+	} else {
+		fm->skew[src] = sample;
+		fm->skewValid |= mask;
+	}
+}
+
+/*	Is header a repetition of the last packet received from its sender? Each
+ *	sender finishes all of its repetitions before sending the next packet, so
+ *	the last sequence number is enough. All of them arrive within t' of the
+ *	first one received, later framelets are new packets even if the sequence
+ *	number matches, e.g. because the sender restarted. Repetitions are timed
+ *	for skew.
+ */
+static bool repetition (fmacCtx * const fm, const uint8_t * const header,
+		const uint32_t time) {
+	const uint8_t src = header[1], seq = header[2];
+	const uint32_t mask = UINT32_C(1)<<src;
+	const uint32_t wait = (fm->kmax*(fm->n-1)+1)*fm->delta;
+	if ((fm->rxSeqValid & mask) && fm->rxSeq[src] == seq &&
+			time - fm->rxFirst[src] < wait) {
+		skew (fm, src, time);
+		return true;
+	}
+	fm->rxSeqValid |= mask;
+	fm->rxSeq[src] = seq;
+	fm->rxFirst[src] = time;
+	return false;
+}
+
+/*	Check verified framelet header for repetitions, which are dropped
+ */
+static bool duplicate (fmacCtx * const fm, const uint8_t * const header,
+		const uint32_t time) {
+	const uint8_t src = header[1];
+
+	if (src >= fm->n || src == fm->i) {
+		debug ("invalid sender %u\n", src);
+		return true;
+	}
+	if (repetition (fm, header, time)) {
+		++fm->duplicates;
+		return true;
+	}
+	return false;
+}
+
+/*	Framelet for another station, dropped by filter. Its header is not
+ *	verified, but still times the sender’s repetitions, so skew covers peers
+ *	that never send to this station as well.
+ */
+static void overheard (fmacCtx * const fm, const uint8_t * const header,
+		const uint32_t time) {
+	++fm->filtered;
+	if (header[1] < fm->n && header[1] != fm->i) {
+		repetition (fm, header, time);
+	}
+}
+
+/*	Pass received framelet body (without header) to the upper layer
+ */
+static void deliver (fmacCtx * const fm, const uint8_t * const body,
+		const size_t bodyLen) {
+	if (fm->rxcb == NULL) {
+		return;
+	}
+
+	if (fm->train > 1) {
+		/* packet train, count followed by payloads with destination and
+		 * length */
+		const uint8_t count = body[0];
+		size_t pos = 1;
+		for (uint8_t j = 0; j < count && j < fm->train; j++) {
+			if (pos+2 > bodyLen) {
+				break;
+			}
+			const uint8_t dest = body[pos++];
+			const uint8_t len = body[pos++];
+			if (len > fm->payloadLen || pos+len > bodyLen) {
+				debug ("invalid train packet length %u\n", len);
+				break;
+			}
+			if (addressed (fm, dest)) {
+				fm->rxcb (fm->cbdata, &body[pos], len);
+			}
+			pos += len;
+		}
+	} else if (bodyLen <= fm->payloadLen) {
+		fm->rxcb (fm->cbdata, body, bodyLen);
+	}
+}
+
+/*	The header is verified now, the destination peeked at before may have
+ *	been wrong
+ */
+static void receive (fmacCtx * const fm, const size_t bodyLen,
+		const uint32_t time) {
+	if (bodyLen > FMAC_HEADER_LEN && addressed (fm, fm->rxPacket[0]) &&
+			!duplicate (fm, fm->rxPacket, time)) {
+		deliver (fm, &fm->rxPacket[FMAC_HEADER_LEN], bodyLen-FMAC_HEADER_LEN);
+	}
+}
+
+/*	Keep framelet that failed to decode. Once three or more copies are
+ *	available, try the bitwise majority of them. Repetitions of the same
+ *	packet are identical on air, so independent bit errors cancel out. Copies
+ *	of different packets just fail the crc. time is the arrival of raw.
+ */
+static void vote (fmacCtx * const fm, const uint32_t * const raw,
+		const uint32_t bits, const uint32_t time) {
+	if (bits == 0) {
+		return;
+	}
+	memcpy (fm->voteBuf[fm->voteNext], raw, (bits+7)/8);
+	fm->voteBits[fm->voteNext] = bits;
+	fm->voteNext = (fm->voteNext+1)%FMAC_VOTE_COPIES;
+	if (fm->voteCount < FMAC_VOTE_COPIES) {
+		++fm->voteCount;
+	}
+	if (fm->voteCount < 3) {
+		return;
+	}
+
+	/* ring is either full or starts at zero */
+	const uint32_t *copies[FMAC_VOTE_COPIES];
+	uint32_t minBits = UINT32_MAX;
+	for (uint8_t j = 0; j < fm->voteCount; j++) {
+		copies[j] = fm->voteBuf[j];
+		if (fm->voteBits[j] < minBits) {
+			minBits = fm->voteBits[j];
+		}
+	}
+	uint32_t voted[FMAC_MAX_PACKET_LEN/4];
+	packetVote (voted, copies, fm->voteCount, (minBits+31)/32);
+
+	size_t bodyLen;
+	if (fm->enc.decode ((uint8_t *) voted, minBits, fm->rxPacket,
+			sizeof (fm->rxPacket), &bodyLen) == PACKET_DECODE_OK) {
+		fm->voteCount = 0;
+		fm->voteNext = 0;
+		++fm->voted;
+		receive (fm, bodyLen, time);
+	}
+}
+
+/*	Decode framelet and deliver it or keep it for voting. stream is the
+ *	streaming decoder fed while reading raw, if any.
+ */
+static void process (fmacCtx * const fm, const uint32_t * const raw,
+		const uint32_t bits, packetStream * const stream, const uint32_t time) {
+	size_t bodyLen;
+	const packetDecodeStatus status = stream != NULL ?
+			fm->enc.streamEnd (stream, &bodyLen) :
+			fm->enc.decode ((const uint8_t *) raw, bits, fm->rxPacket,
+			sizeof (fm->rxPacket), &bodyLen);
+	if (status == PACKET_DECODE_OK) {
+		/* failed copies are likely repetitions of this one */
+		fm->voteCount = 0;
+		fm->voteNext = 0;
+		receive (fm, bodyLen, time);
+	} else {
+		vote (fm, raw, bits, time);
+	}
+}
 
-	uint8_t rxPacket[FMAC_MAX_PACKET_LEN];
-	bitbuffer rxPacketBuf;
-	bitbufferInit (&rxPacketBuf, (uint32_t *) rxPacket, sizeof (rxPacket)*8);
+/*	Peek at the header before decoding the framelet. If it does not decode it
+ *	may still be correctable, so keep the framelet. Otherwise header is valid
+ *	when false is returned, see overheard.
+ */
+static bool filter (const fmacCtx * const fm, const uint32_t * const raw,
+		const uint32_t bits, uint8_t * const header) {
+	return !fm->enc.peek ((const uint8_t *) raw, bits, header,
+			FMAC_HEADER_LEN) || addressed (fm, header[0]);
+}
+
+/*	Read framelet from the tda’s fifo into raw (size bytes), feeding stream
+ *	if not NULL. Returns its length in bits, zero on fifo overflow.
+ */
+static uint32_t drain (fmacCtx * const fm, tda5340Ctx * const tda,
+		uint32_t * const raw, const size_t size, packetStream *stream) {
+	bitbuffer buf;
+	bitbufferInit (&buf, raw, size*8);
 
 	while (true) {
 		uint32_t block;
 		uint8_t bits;
 		if (!tda5340FifoRead (tda, &block, &bits)) {
 			debug ("fifo overflow\n");
-			goto done;
+			return 0;
 		}
 		if (bits == 0) {
 			/* eom */
 			break;
 		}
-		if (!bitbufferPush32 (&rxPacketBuf, block, bits)) {
+		if (!bitbufferPush32 (&buf, block, bits)) {
 			assert (0);
 		}
+		if (stream != NULL) {
+			fm->enc.streamPush (stream, block, bits);
+			/* stop decoding once the destination is known to be another
+			 * station, dest receives the body after the length byte */
+			if (stream->pos > 1 && !addressed (fm, stream->dest[0])) {
+				stream = NULL;
+			}
+		}
 	}
-	const uint32_t rxLen = bitbufferLength (&rxPacketBuf);
-	//debug ("received %u bits\n", rxLen);
+	//debug ("received %u bits\n", bitbufferLength (&buf));
+	return bitbufferLength (&buf);
+}
+
+static void rxeom (tda5340Ctx * const tda, void * const data) {
+	fmacCtx * const fm = data;
+	assert (fm != NULL);
+
+	RX_LED_FIRE;
+	const uint32_t start = timerNow ();
+
+#ifdef FMAC_DEFER_RX
+	/* runs above the timer interrupt, so only queue the framelet, see
+	 * fmacProcess */
+	if ((uint8_t) (fm->rxHead - fm->rxTail) == FMAC_RX_QUEUE) {
+		uint32_t discard[FMAC_MAX_PACKET_LEN/4];
+		drain (fm, tda, discard, sizeof (discard), NULL);
+		++fm->rxDropped;
+	} else {
+		fmacRxFramelet * const f = &fm->rxQueue[fm->rxHead%FMAC_RX_QUEUE];
+		f->time = start;
+		f->bits = drain (fm, tda, f->raw, sizeof (f->raw), NULL);
+		if (f->bits > 0) {
+			/* framelets for other stations are queued as well, the sender
+			 * state is only touched by fmacProcess */
+			f->filtered = !filter (fm, f->raw, f->bits, f->header);
+			++fm->rxHead;
+		}
+	}
+#else
+	/* decode blocks as they are read if the encoder supports it, so only
+	 * the crc check is left at the end */
+	uint32_t raw[FMAC_MAX_PACKET_LEN/4];
+	packetStream stream;
+	packetStream * const s = fm->enc.streamBegin != NULL ? &stream : NULL;
+	if (s != NULL) {
+		fm->enc.streamBegin (s, fm->rxPacket, sizeof (fm->rxPacket));
+	}
+	const uint32_t bits = drain (fm, tda, raw, sizeof (raw), s);
+	uint8_t header[FMAC_HEADER_LEN];
+	if (bits > 0) {
+		if (filter (fm, raw, bits, header)) {
+			process (fm, raw, bits, s, start);
+		} else {
+			overheard (fm, header, start);
+		}
+	}
+#endif
 
-	if (fm->enc.decode (rxPacket, rxLen, fm->rxPacket,
-			sizeof (fm->rxPacket)) == PACKET_DECODE_OK && fm->rxcb != NULL) {
-		fm->rxcb (fm->cbdata, fm->rxPacket, fm->payloadLen);
+	const uint32_t eom = timerNow () - start;
+	if (eom > fm->calEom) {
+		fm->calEom = eom;
 	}
 
 	DEBUG_TIMING_FMAC_RCV_FIRE;
-done: ;
 	RX_LED_FIRE;
 }
 
-static void stop () {
-	XMC_CCU4_SLICE_StopTimer (SLICE_COMPARE_LOWER);
-	XMC_CCU4_SLICE_StopTimer (SLICE_COMPARE_UPPER);
-}
+_Static_assert ((FMAC_RX_QUEUE & (FMAC_RX_QUEUE-1)) == 0,
+		"rx queue indices wrap around");
 
-static void event (fmacCtx * const fm, const uint32_t timer) {
-	assert (!XMC_CCU4_SLICE_IsTimerRunning (SLICE_COMPARE_LOWER));
-	assert (!XMC_CCU4_SLICE_IsTimerRunning (SLICE_COMPARE_UPPER));
+/*	Bottom half of rxeom, decodes and delivers queued framelets. Also fetches
+ *	the next packet with txcb if asked to, see fmacPoll. Call from the main
+ *	loop, where the timer interrupt can preempt it.
+ */
+void fmacProcess (fmacCtx * const fm) {
+	while (fm->rxHead != fm->rxTail) {
+		const fmacRxFramelet * const f = &fm->rxQueue[fm->rxTail%FMAC_RX_QUEUE];
+		if (f->filtered) {
+			overheard (fm, f->header, f->time);
+		} else {
+			process (fm, f->raw, f->bits, NULL, f->time);
+		}
+		++fm->rxTail;
+	}
 
-	XMC_CCU4_SLICE_ClearTimer (SLICE_COMPARE_LOWER);
-	XMC_CCU4_SLICE_ClearTimer (SLICE_COMPARE_UPPER);
-	//SEGGER_RTT_printf (0, "x: %08x\n", timer);
+	if (fm->txPoll) {
+		/* cleared first, so polls while fetching are not lost. Packets are
+		 * only fetched shortly before they can be sent, so a train collects
+		 * as many as possible and none is held back for a whole t'. */
+		fm->txPoll = false;
+		const void *data;
+		size_t size;
+		uint8_t dest;
+		if (fm->initialized && fmacCanSend (fm) &&
+				(fm->state == FMAC_IDLE || fm->txOpen) && fm->txcb != NULL &&
+				fm->txcb (fm->cbdata, &data, &size, &dest)) {
+			fmacSend (fm, dest, data, size);
+		}
+	}
+}
 
-	XMC_CCU4_SLICE_SetTimerCompareMatch (SLICE_COMPARE_LOWER, timer);
-	XMC_CCU4_SLICE_SetTimerCompareMatch (SLICE_COMPARE_UPPER, timer >> 16);
+/*	Schedule the next event timer ticks after the previous one. Deadlines are
+ *	absolute, so interrupt latency does not add up over a sequence.
+ */
+static void event (fmacCtx * const fm, const uint32_t timer) {
+	fm->deadline += timer;
+	timerStartAt (&fm->timer, fm->deadline, 0);
+}
 
-	/* transfer new compare value */
-	XMC_CCU4_EnableShadowTransfer (MODULE_PTR, SLICE_COMPARE_LOWER_SHADOW);
-	XMC_CCU4_EnableShadowTransfer (MODULE_PTR, SLICE_COMPARE_UPPER_SHADOW);
+/*	Send the next repetition of the current sequence
+ */
+static void repeat (fmacCtx * const fm) {
+	++fm->repetition;
+	if (fm->repetition == fm->n) {
+		fm->state = FMAC_WAIT_END;
+		/* wait t' */
+		event (fm, (fm->kmax*(fm->n-1)+1)*fm->delta);
+		/* fetch the next packet one δ before, see fmacProcess */
+		timerStartAt (&fm->prepare, fm->deadline - fm->delta, 0);
+	} else {
+		/* wait t_i */
+		event (fm, fm->delta*fm->k[fm->i]);
+	}
+	if (!flush (fm)) {
+		/* ignore failed flush, try again next time */
+		debug ("flush failed\n");
+	}
+}
 
-#if 0
-	/* XXX: does not fix the issue with xmc1100 */
-	/* wait for transfer to complete, no xmclib function for that? */
-	_Static_assert (SLICE_COMPARE_LOWER_NO == 0 && SLICE_COMPARE_UPPER_NO == 1, "fix this as well");
-	while (MODULE_PTR->GCST & CCU4_GCST_S0SS_Msk || MODULE_PTR->GCST & CCU4_GCST_S1SS_Msk);
-#endif
+/*	Start a sequence with the framelet encoded by fmacSend
+ */
+static void start (fmacCtx * const fm) {
+	assert (fm->txNext);
 
-	XMC_CCU4_SLICE_StartTimer (SLICE_COMPARE_LOWER);
-	XMC_CCU4_SLICE_StartTimer (SLICE_COMPARE_UPPER);
+	fm->txCurrent ^= 1;
+	/* δ written since applies from here, repetitions are never respaced */
+	fm->delta = fm->deltaNext;
+	fm->state = FMAC_SEND;
+	fm->repetition = 0;
+	fm->txOpen = false;
+	/* the other buffer is free for fmacSend again */
+	fm->txNext = false;
+	repeat (fm);
 }
 
 static void dispatch (fmacCtx * const fm) {
 	switch (fm->state) {
 		case FMAC_IDLE:
-			/* pass */
-			assert (0);
+			/* started by fmacSend */
+			start (fm);
 			break;
 
 		case FMAC_SEND:
 			/* sending sequence */
-			++fm->repetition;
-			if (fm->repetition == fm->n) {
-				fm->state = FMAC_WAIT_END;
-				fm->txPacketValid = false;
-				/* wait t' */
-				event (fm, (fm->kmax*(fm->n-1)+1)*fm->delta);
-			} else {
-				/* wait t_i */
-				event (fm, fm->delta*fm->k[fm->i]);
-			}
-			if (!flush (fm)) {
-				/* ignore failed flush, try again next time */
-				debug ("flush failed\n");
-			}
+			repeat (fm);
 			break;
 
 		case FMAC_WAIT_END:
-			/* done, ready for a new packet */
+			/* done, fmacSend starts the next sequence unless it is encoded
+			 * already. Checked after changing the state, so one of both sees
+			 * the other. */
 			fm->state = FMAC_IDLE;
 			/* XXX: we should enforce switching to rx here if it failed for some reason */
-			if (fm->txcb != NULL) {
+			if (fm->txNext) {
 #ifdef DEBUG_RANDOM_DELAY
 				const unsigned int wait = rand ()%(DEBUG_RANDOM_DELAY);
 				for (volatile unsigned int i = 0; i < wait; i++);
 #endif
-				const void *data;
-				size_t size;
-				if (fm->txcb (fm->cbdata, &data, &size)) {
-					fmacSend (fm, data, size);
-				}
+				start (fm);
 			}
 			break;
 
@@ -234,49 +535,24 @@ static void dispatch (fmacCtx * const fm) {
 	}
 }
 
-/*	Initialize compare timer slices
+/*	Timer callback, the current sequence ends in δ
  */
-static void compareInit (const XMC_CCU4_SLICE_PRESCALER_t prescaler,
-		const uint32_t priority) {
-	XMC_CCU4_SLICE_COMPARE_CONFIG_t config = {
-		.timer_mode 		     = XMC_CCU4_SLICE_TIMER_COUNT_MODE_EA,
-		/* monoshot does not work well with timer concat */
-		.monoshot   		     = XMC_CCU4_SLICE_TIMER_REPEAT_MODE_REPEAT,
-		.shadow_xfer_clear   = 0U,
-		.dither_timer_period = 0U,
-		.dither_duty_cycle   = 0U,
-		.prescaler_mode	     = XMC_CCU4_SLICE_PRESCALER_MODE_NORMAL,
-		.mcm_enable		       = 0U,
-		.prescaler_initval   = prescaler,
-		.float_limit		     = 0U,
-		.dither_limit		     = 0U,
-		.passive_level 	     = XMC_CCU4_SLICE_OUTPUT_PASSIVE_LEVEL_LOW,
-		.timer_concatenation = 0U
-	};
+static void prepare (timer * const t, void * const data) {
+	fmacCtx * const fm = data;
+	assert (fm != NULL);
 
-	/* Get the slice out of idle mode */
-	XMC_CCU4_EnableClock(MODULE_PTR, SLICE_COMPARE_LOWER_NO);
-	XMC_CCU4_EnableClock(MODULE_PTR, SLICE_COMPARE_UPPER_NO);
-
-	/* Initialize the Slice */
-	XMC_CCU4_SLICE_CompareInit(SLICE_COMPARE_LOWER, &config);
-	config.timer_concatenation = 1;
-	XMC_CCU4_SLICE_CompareInit(SLICE_COMPARE_UPPER, &config);
-
-	/* the signal is forwarded from the lsb slice to the msb slice and combined
-	 * there */
-	XMC_CCU4_SLICE_EnableEvent(SLICE_COMPARE_UPPER,
-			XMC_CCU4_SLICE_IRQ_ID_COMPARE_MATCH_UP);
-
-	/* Configure interrupts */
-	/* compare match */
-	XMC_CCU4_SLICE_SetInterruptNode(SLICE_COMPARE_UPPER,
-			XMC_CCU4_SLICE_IRQ_ID_COMPARE_MATCH_UP, XMC_CCU4_SLICE_SR_ID_0);
-	NVIC_SetPriority(CCU40_0_IRQn, priority);
-	NVIC_EnableIRQ(CCU40_0_IRQn);
-
-	XMC_CCU4_SLICE_SetTimerPeriodMatch (SLICE_COMPARE_LOWER, 0xffff);
-	XMC_CCU4_SLICE_SetTimerPeriodMatch (SLICE_COMPARE_UPPER, 0xffff);
+	fm->txOpen = true;
+	fmacPoll (fm);
+}
+
+/*	Timer callback, the next event is due
+ */
+static void expired (timer * const t, void * const data) {
+	fmacCtx * const fm = data;
+	assert (fm != NULL);
+
+	DEBUG_TIMING_FMAC_IRQ_FIRE;
+	dispatch (fm);
 }
 
 #include <tda5340_reg.h>
@@ -339,46 +615,90 @@ const tdaConfigVal tdaConfig[] = {
 	};
 const size_t tdaConfigSize = arraysize (tdaConfig);
 
-/* from paper */
-static const uint32_t optimalK[] = {
-	2, 3, /* n=2 */
-	2, 3, 5, /* n=3 */
-	};
-static const uint32_t optimalKOff[] = {
-	-1,
-	-1,
-	0, /* n=2 */
-	2, /* n=3 */
-	};
-
-/*	Init fmac. Needs a buf of at least len bytes for storing temporory packets.
- *	len includes runin and sync.
+/*	Init fmac for packets of up to payloadLen bytes. δ is sized for the
+ *	longest framelet, since all stations must use the same δ. Shorter packets
+ *	just occupy the channel for a shorter time. With train>1 each framelet
+ *	carries up to train packets, so a saturated station sends train packets per
+ *	cycle instead of one. δ grows with the framelet, but the rx/tx switching
+ *	time is paid only once. train is capped to what fits into
+ *	FMAC_MAX_BODY_LEN, see fmacMaxTrain. encoder is one of the PACKET_*
+ *	encoders.
  */
 void fmacInit (fmacCtx * const fm, const uint8_t i, const uint8_t n,
-		tda5340Ctx * const tda, const uint8_t payloadLen) {
+		tda5340Ctx * const tda, const uint8_t payloadLen, const uint8_t train,
+		const uint8_t encoder) {
 	assert (i < n);
 	assert (fm != NULL);
 	assert (tda != NULL);
+	assert (payloadLen <= FMAC_MAX_PAYLOAD_LEN);
+
+	/* reconfiguring from the main loop: keep the timer and tda interrupts
+	 * away from the state reset below, the tda skips missing callbacks */
+	fm->initialized = false;
+	timerStop (&fm->timer);
+	timerStop (&fm->prepare);
+	tda->rxeom = NULL;
+	tda->txready = NULL;
+	tda->txempty = NULL;
+	atomic_signal_fence (memory_order_seq_cst);
 
-	packet8b10bInit (&fm->enc);
-	fm->txPacketValid = false;
+	if (!packetInit (&fm->enc, encoder)) {
+		debug ("invalid encoder %u, using default\n", encoder);
+		const bool ret = packetInit (&fm->enc, PACKET_ENCODER);
+		assert (ret);
+	}
+	fm->txNext = false;
+	fm->txOpen = false;
+	fm->txCurrent = 0;
 	fm->payloadLen = payloadLen;
-	fm->frameletLen = fm->enc.txlen (payloadLen);
+	/* the host may ask for more than fits into one framelet */
+	const uint8_t maxTrain = fmacMaxTrain (payloadLen);
+	fm->train = train > maxTrain ? maxTrain : train;
+	size_t bodyLen;
+	if (fm->train > 1) {
+		/* count byte and payloads with destination and length */
+		bodyLen = FMAC_HEADER_LEN+1+(size_t) fm->train*(2+payloadLen);
+	} else {
+		bodyLen = FMAC_HEADER_LEN+payloadLen;
+	}
+	assert (bodyLen <= FMAC_MAX_BODY_LEN);
+	fm->bodyLen = bodyLen;
+	fm->txSeq = 0;
+	fm->rxSeqValid = 0;
+	fm->duplicates = 0;
+	fm->voteCount = 0;
+	fm->voteNext = 0;
+	fm->voted = 0;
+	fm->rxHead = 0;
+	fm->rxTail = 0;
+	fm->rxDropped = 0;
+	fm->filtered = 0;
+	fm->frameletLen = fm->enc.txlen (fm->bodyLen);
 	assert (fm->frameletLen < FMAC_MAX_PACKET_LEN);
 	fm->tda = tda;
-	const uint32_t usPerBit = 10;
 	/* delta includes packet time and rx→tx/tx→rx switch, δ=2d, for packet length d */
-	fm->delta = US_TO_TICKS ((fm->frameletLen*8*usPerBit+RXTX_SWITCHING_US*2)*2)*DELTA_SCALER+US_TO_TICKS(CORRECTION_US);
+	fm->deltaDefault = TIMER_US_TO_TICKS ((fm->frameletLen*8*US_PER_BIT+RXTX_SWITCHING_US*2)*2)*DELTA_SCALER+TIMER_US_TO_TICKS(CORRECTION_US);
+	fm->delta = fm->deltaDefault;
+	fm->deltaNext = fm->deltaDefault;
+	fm->calSwitch = 0;
+	fm->calAir = 0;
+	fm->calAirBytes = 0;
+	fm->calEom = 0;
+	fm->calPending = false;
+	fm->skewValid = 0;
 	fm->i = i;
 	fm->n = n;
-	assert (n < sizeof (optimalKOff)/sizeof (*optimalKOff));
-	fm->k = &optimalK[optimalKOff[n]];
-	fm->kmax = 0;
-	for (uint8_t j = 0; j < n; j++) {
-		fm->kmax = fm->k[j] > fm->kmax ? fm->k[j] : fm->kmax;
-	}
-	debug ("fmac init station %u, frameletLen %u, delta %u, kmax %u\n", fm->i,
-			fm->frameletLen, fm->delta, fm->kmax);
+	if (n <= KSET_TABLE_MAX_N) {
+		fm->k = &ksetTable[ksetTableOff[n]];
+	} else {
+		/* too large for the table, slower and not optimal */
+		const bool ret = ksetGreedy (fm->kbuf, n);
+		assert (ret);
+		fm->k = fm->kbuf;
+	}
+	fm->kmax = ksetMax (fm->k, n);
+	debug ("fmac init station %u, frameletLen %u, train %u, delta %u, kmax %u\n",
+			fm->i, fm->frameletLen, fm->train, fm->delta, fm->kmax);
 	fm->initialized = true;
 
 	/* set up tda */
@@ -388,56 +708,164 @@ void fmacInit (fmacCtx * const fm, const uint8_t i, const uint8_t n,
 	tda->fsInitFifo = true;
 	bool ret = tda5340RegWriteBulk (tda, tdaConfig, tdaConfigSize);
 	assert (ret);
-	/* payload bits (8b10b encoded) */
-	tda5340RegWrite (tda, TDA_B_EOMDLEN, fm->enc.rxlen (fm->payloadLen));
+	/* max payload bits (8b10b encoded), shorter packets end with sync loss */
+	tda5340RegWrite (tda, TDA_B_EOMDLEN, fm->enc.rxlen (fm->bodyLen));
 	tda5340ModeSet (tda, TDA_RUN_MODE_SLAVE, false, TDA_CONFIG_B);
 
-	crc32Init (payloadLen+4);
+	packetCrcInit ();
 
-	XMC_CCU4_SetModuleClock(MODULE_PTR, XMC_CCU4_CLOCK_SCU);
-	XMC_CCU4_Init(MODULE_PTR, XMC_CCU4_SLICE_MCMS_ACTION_TRANSFER_PR_CR);
-	XMC_CCU4_StartPrescaler(MODULE_PTR);
+	/* the timer service runs already, see timerInit */
+	timerSetup (&fm->timer, expired, fm);
+	timerSetup (&fm->prepare, prepare, fm);
 
-	const uint32_t priority = NVIC_EncodePriority(NVIC_GetPriorityGrouping(),
-			PRIO_SCHED_PREEMPT, PRIO_SCHED_SUB);
-	compareInit (PRESCALER, priority);
+	/* fetch packets queued before */
+	fm->state = FMAC_IDLE;
+	fm->txPoll = true;
+}
 
-	/* make sure txcb is called upon startup */
-	fm->state = FMAC_WAIT_END;
-	dispatch (fm);
+/*	Guard time measured while sending. The tda only reports rx→tx switching
+ *	(txready), tx→rx is assumed to take as long. δ must cover a full framelet
+ *	and both switches twice, plus the longest time rxeom delays the timer
+ *	interrupt. Peers with skewed clocks drift by up to a whole cycle t' against
+ *	our sequence, which is added as well.
+ */
+void fmacGetTiming (const fmacCtx * const fm, fmacTiming * const t) {
+	t->delta = TIMER_TICKS_TO_US (fm->deltaNext);
+	t->switching = TIMER_TICKS_TO_US (fm->calSwitch);
+	t->eom = TIMER_TICKS_TO_US (fm->calEom);
+	t->drift = 0;
+	t->drifting = 0;
+	for (uint8_t j = 0; j < fm->n; j++) {
+		int32_t ppm;
+		if (fmacGetSkew (fm, j, &ppm)) {
+			const uint32_t abs = ppm < 0 ? -ppm : ppm;
+			if (abs > t->drift) {
+				t->drift = abs;
+			}
+			if (abs > FMAC_DRIFT_MAX_PPM) {
+				t->drifting |= UINT32_C(1) << j;
+			}
+		}
+	}
+	if (fm->calAirBytes > 0) {
+		const uint32_t air = (fm->calAir*fm->frameletLen+fm->calAirBytes-1)/
+				fm->calAirBytes;
+		const uint64_t cycle = (uint64_t) (fm->kmax*(fm->n-1)+1)*fm->delta;
+		const uint32_t drift = (cycle*t->drift+999999)/1000000;
+		t->airtime = TIMER_TICKS_TO_US (air);
+		t->calibrated = TIMER_TICKS_TO_US ((air+2*fm->calSwitch+fm->calEom+drift)*2);
+	} else {
+		t->airtime = 0;
+		t->calibrated = 0;
+	}
+}
+
+/*	Clock skew of station relative to ours in ppm, positive if it runs fast.
+ *	False until two repetitions of one of its packets were received.
+ */
+bool fmacGetSkew (const fmacCtx * const fm, const uint8_t station,
+		int32_t * const ppm) {
+	if (station >= fm->n || !(fm->skewValid & (UINT32_C(1) << station))) {
+		return false;
+	}
+	*ppm = fm->skew[station]/16;
+	return true;
 }
 
-/*	Start sending payload data of len bytes, excluding preable and crc32
+/*	Override δ, 0 restores the default. All stations must use the same δ, so
+ *	the host should apply the largest calibrated δ of all stations everywhere.
+ *	δ must cover twice the airtime of a framelet and both switches, like
+ *	CALDELTA, using the measured values once there are some. The new δ
+ *	applies from the next sequence on, the one being sent keeps its spacing.
  */
-bool fmacSend (fmacCtx * const fm, const uint8_t * const buf, const uint8_t len) {
+void fmacSetDelta (fmacCtx * const fm, const uint32_t us) {
+	uint32_t air = TIMER_US_TO_TICKS (fm->frameletLen*8*US_PER_BIT);
+	if (fm->calAirBytes > 0) {
+		const uint32_t measured = (fm->calAir*fm->frameletLen+fm->calAirBytes-1)/
+				fm->calAirBytes;
+		air = measured > air ? measured : air;
+	}
+	const uint32_t switching = fm->calSwitch > 0 ? fm->calSwitch :
+			TIMER_US_TO_TICKS (RXTX_SWITCHING_US);
+	const uint32_t min = (air+2*switching)*2;
+	if (us == 0) {
+		fm->deltaNext = fm->deltaDefault;
+	} else {
+		const uint32_t ticks = TIMER_US_TO_TICKS (us);
+		fm->deltaNext = ticks < min ? min : ticks;
+	}
+	debug ("delta %u\n", fm->deltaNext);
+}
+
+/*	Queue payload data of up to payloadLen bytes to dest, excluding preable
+ *	and crc. In train mode other queued packets are sent along, the framelet
+ *	is broadcast if their destinations differ. The framelet is encoded right
+ *	away, into the buffer not used by the current sequence, which is the one
+ *	packet queued. The timer interrupt starts it as soon as the current
+ *	sequence is done. Returns false without taking the packet while that
+ *	buffer is occupied (see fmacCanSend), the caller keeps it queued. Call
+ *	from the main loop, the timer interrupt must be able to preempt this.
+ */
+bool fmacSend (fmacCtx * const fm, const uint8_t dest,
+		const uint8_t * const buf, const uint8_t len) {
 	if (!fm->initialized || !fmacCanSend (fm)) {
 		return false;
 	}
 	DEBUG_TIMING_FMAC_SEND_FIRE;
 
-	assert (!fm->txPacketValid);
-	assert (len == fm->payloadLen);
-	size_t actualLenBits = fm->enc.encode (buf, len, fm->txPacket, sizeof (fm->txPacket));
+	assert (len > 0 && len <= fm->payloadLen);
+	uint8_t body[FMAC_MAX_BODY_LEN];
+	size_t bodyLen = FMAC_HEADER_LEN;
+	body[0] = dest;
+	body[1] = fm->i;
+	body[2] = fm->txSeq++;
+	if (fm->train > 1) {
+		uint8_t * const train = &body[FMAC_HEADER_LEN];
+		train[1] = dest;
+		train[2] = len;
+		memcpy (&train[3], buf, len);
+		bodyLen += 3+len;
+		uint8_t count = 1;
+		const void *data;
+		size_t size;
+		uint8_t next;
+		/* txcb dequeues, so only ask for a packet if the longest one fits */
+		while (count < fm->train && fm->txcb != NULL &&
+				bodyLen+2+fm->payloadLen <= fm->bodyLen &&
+				fm->txcb (fm->cbdata, &data, &size, &next)) {
+			assert (size > 0 && size <= fm->payloadLen);
+			assert (bodyLen+2+size <= fm->bodyLen);
+			if (next != dest) {
+				body[0] = FMAC_ADDR_BROADCAST;
+			}
+			body[bodyLen++] = next;
+			body[bodyLen++] = size;
+			memcpy (&body[bodyLen], data, size);
+			bodyLen += size;
+			++count;
+		}
+		train[0] = count;
+	} else {
+		memcpy (&body[bodyLen], buf, len);
+		bodyLen += len;
+	}
+	assert (bodyLen <= fm->bodyLen);
+	const uint8_t next = fm->txCurrent ^ 1;
+	size_t actualLenBits = fm->enc.encode (body, bodyLen, fm->txPacket[next],
+			sizeof (fm->txPacket[next]));
 	assert (actualLenBits <= fm->frameletLen*8);
-
-	fm->state = FMAC_SEND;
-	fm->txPacketValid = true;
-	fm->repetition = 0;
-	dispatch (fm);
+	fm->txPacketLen[next] = (actualLenBits+7)/8;
+
+	/* hand the framelet to the timer interrupt, then check whether it is
+	 * waiting for one, see dispatch */
+	atomic_signal_fence (memory_order_release);
+	fm->txNext = true;
+	if (fm->state == FMAC_IDLE) {
+		/* repetitions are scheduled relative to the first one, which is sent
+		 * from the timer interrupt as well, so they see the same latency */
+		fm->deadline = timerNow ();
+		timerStartAt (&fm->timer, fm->deadline, 0);
+	}
 
 	return true;
 }
-
-void fmacIrqHandle (fmacCtx * const fm) {
-	assert (fm != NULL);
-
-	DEBUG_TIMING_FMAC_IRQ_FIRE;
-	/* XXX: cleared by hardware? */
-	//XMC_CCU4_SLICE_ClearEvent(SLICE_COMPARE_LOWER, XMC_CCU4_SLICE_IRQ_ID_COMPARE_MATCH_UP);
-	//XMC_CCU4_SLICE_ClearEvent(SLICE_COMPARE_UPPER, XMC_CCU4_SLICE_IRQ_ID_COMPARE_MATCH_UP);
-	stop ();
-	//SEGGER_RTT_printf (0, "h: %04x%04x\n", XMC_CCU4_SLICE_GetTimerValue (CCU40_CC41), XMC_CCU4_SLICE_GetTimerValue (CCU40_CC40));
-
-	dispatch (fm);
-}
-
@@ -25,15 +25,64 @@ THE SOFTWARE.
 #include <tda5340.h>
 
 /* max packet length in bytes, including preamble, runin and crc, 8b10b encoded payload */
-#define FMAC_MAX_PACKET_LEN (64)
-
-/* size in bytes */
+#define FMAC_MAX_PACKET_LEN (96)
+/* max payload of a single packet from/to the host */
+#define FMAC_MAX_PAYLOAD_LEN (32)
+/* max framelet body (header and payload or packet train) before encoding,
+ * without crc */
+#define FMAC_MAX_BODY_LEN (60)
+/* framelet header: destination, sender station id and sequence number. The
+ * destination comes first, so receivers can drop framelets for other
+ * stations as soon as it is decoded */
+#define FMAC_HEADER_LEN (3)
+/* destinations: station ids below FMAC_ADDR_GROUP, multicast groups
+ * FMAC_ADDR_GROUP+g for g < FMAC_ADDR_GROUPS, and broadcast */
+#define FMAC_ADDR_GROUP (0x80)
+#define FMAC_ADDR_GROUPS (32)
+#define FMAC_ADDR_BROADCAST (0xff)
+/* failed framelets kept for majority voting, at most 7 */
+#define FMAC_VOTE_COPIES (5)
+/* received framelets waiting for fmacProcess, power of two */
+#define FMAC_RX_QUEUE (4)
+/* peers whose clock is off by more than this many ppm are flagged, see
+ * fmacGetTiming */
+#ifndef FMAC_DRIFT_MAX_PPM
+#define FMAC_DRIFT_MAX_PPM (500)
+#endif
+
+/* size in bytes, dest is one of the FMAC_ADDR_* destinations */
 typedef bool (*fmacTxCallback) (void * const data,
-		const void ** const payload, size_t * const size);
+		const void ** const payload, size_t * const size, uint8_t * const dest);
 typedef bool (*fmacRxCallback) (void * const data, const void * const payload,
 			const size_t size);
 
 #include "packet.h"
+#include "kset.h"
+#include "timer.h"
+
+/* framelet as read from the tda’s fifo */
+typedef struct {
+	uint32_t raw[FMAC_MAX_PACKET_LEN/4];
+	uint16_t bits;
+	/* clock at end of message, see timerNow */
+	uint32_t time;
+	/* for another station, only its peeked header is used */
+	bool filtered;
+	uint8_t header[FMAC_HEADER_LEN];
+} fmacRxFramelet;
+
+/* guard time calibration, all in μs */
+typedef struct {
+	/* δ in use and the tightest one derived from the measurements below, 0
+	 * until a framelet was sent */
+	uint32_t delta, calibrated;
+	/* longest rx→tx switch, airtime of a full framelet and longest time the
+	 * end of message handler blocked the timer interrupt */
+	uint32_t switching, airtime, eom;
+	/* largest clock skew of any peer in ppm and peers above
+	 * FMAC_DRIFT_MAX_PPM, bit i for station i */
+	uint32_t drift, drifting;
+} fmacTiming;
 
 typedef struct {
 	volatile enum {
@@ -44,20 +93,81 @@ typedef struct {
 		FMAC_WAIT_END,
 	} state;
 
-	/* framelet length (whole packet on air), payload len (no preamble, crc, …) */
+	/* max framelet length (whole packet on air), max payload len (no
+	 * preamble, crc, …) */
 	uint8_t frameletLen, payloadLen;
-	/* fmac base unit, δ, in μs */
-	uint32_t delta;
+	/* max packets per framelet and resulting max body length (header,
+	 * payloads and train header) */
+	uint8_t train, bodyLen;
+	/* fmac base unit, δ, in timer ticks, the one computed by fmacInit and the
+	 * one the next sequence starts with, see fmacSetDelta */
+	uint32_t delta, deltaDefault, deltaNext;
+	/* guard time measurements in ticks, see fmacGetTiming: longest rx→tx
+	 * switch, airtime and encoded length of the slowest framelet per byte and
+	 * longest rxeom */
+	uint32_t calSwitch, calAir, calAirBytes, calEom;
+	/* timer value when tx mode was requested and when sending started */
+	uint32_t calFlush, calTxStart;
+	/* calFlush is valid */
+	bool calPending;
+	/* clock value of the next event, see timerNow */
+	uint32_t deadline;
+	/* the next event and fetching the next packet during t' */
+	timer timer, prepare;
+	/* time of the first repetition received of each sender’s current
+	 * packet */
+	uint32_t rxFirst[KSET_MAX_N];
+	/* clock skew of each sender relative to ours in 1/16 ppm, positive if
+	 * it runs fast, valid if bit i of skewValid is set */
+	int32_t skew[KSET_MAX_N];
+	uint32_t skewValid;
 	/* station id, i and number of stations, n*/
 	uint32_t i, n;
 	const uint32_t *k;
 	uint32_t kmax;
+	/* k-set storage if not taken from the table */
+	uint32_t kbuf[KSET_MAX_N];
 	/* current packet repetiton */
 	uint8_t repetition;
+	/* sequence number of the next packet sent */
+	uint8_t txSeq;
+	/* last sequence number received from each station, valid if bit i of
+	 * rxSeqValid is set */
+	uint8_t rxSeq[KSET_MAX_N];
+	uint32_t rxSeqValid;
+	/* repetitions dropped */
+	uint32_t duplicates;
+	/* raw framelets that failed to decode, ring buffer for majority voting */
+	uint32_t voteBuf[FMAC_VOTE_COPIES][FMAC_MAX_PACKET_LEN/4];
+	uint16_t voteBits[FMAC_VOTE_COPIES];
+	uint8_t voteCount, voteNext;
+	/* packets recovered by voting */
+	uint32_t voted;
+	/* received framelets, written by rxeom, decoded by fmacProcess */
+	fmacRxFramelet rxQueue[FMAC_RX_QUEUE];
+	volatile uint8_t rxHead, rxTail;
+	/* framelets dropped because the queue was full */
+	uint32_t rxDropped;
+	/* multicast groups this station belongs to, bit g for
+	 * FMAC_ADDR_GROUP+g. Kept by fmacInit */
+	uint32_t groups;
+	/* framelets for other stations, dropped by their header */
+	uint32_t filtered;
 
 	/* current framelet */
-	uint8_t rxPacket[FMAC_MAX_PACKET_LEN], txPacket[FMAC_MAX_PACKET_LEN];
-	bool rxPacketValid, txPacketValid;
+	uint8_t rxPacket[FMAC_MAX_PACKET_LEN];
+	bool rxPacketValid;
+	/* framelets of the current sequence, txCurrent, and the next one,
+	 * encoded ahead by fmacSend. txNext hands the latter to the timer
+	 * interrupt, which flips txCurrent when starting its sequence */
+	uint8_t txPacket[2][FMAC_MAX_PACKET_LEN];
+	/* encoded length of txPacket in bytes, at most frameletLen */
+	uint8_t txPacketLen[2];
+	uint8_t txCurrent;
+	volatile bool txNext;
+	/* fetch a packet with txcb in fmacProcess, see fmacPoll. It may be sent
+	 * right away if txOpen is set */
+	volatile bool txPoll, txOpen;
 
 	tda5340Ctx *tda;
 	packetEncoder enc;
@@ -70,11 +180,42 @@ typedef struct {
 	uint8_t initialized;
 } fmacCtx;
 
-void fmacIrqHandle (fmacCtx * const fm);
-bool fmacSend (fmacCtx * const fm, const uint8_t * const buf, const uint8_t len);
+void fmacProcess (fmacCtx * const fm);
+bool fmacSend (fmacCtx * const fm, const uint8_t dest,
+		const uint8_t * const buf, const uint8_t len);
 void fmacInit (fmacCtx * const fm, const uint8_t i, const uint8_t n,
-		tda5340Ctx * const tda, const uint8_t payloadSize);
+		tda5340Ctx * const tda, const uint8_t payloadSize, const uint8_t train,
+		const uint8_t encoder);
+void fmacGetTiming (const fmacCtx * const fm, fmacTiming * const t);
+void fmacSetDelta (fmacCtx * const fm, const uint32_t us);
+bool fmacGetSkew (const fmacCtx * const fm, const uint8_t station,
+		int32_t * const ppm);
+
+/*	Longest train whose framelet body still fits FMAC_MAX_BODY_LEN with
+ *	payloads of payloadLen bytes, 1 if not even two packets fit
+ */
+inline static uint8_t fmacMaxTrain (const uint8_t payloadLen) {
+	const size_t max = (FMAC_MAX_BODY_LEN-FMAC_HEADER_LEN-1)/(2+payloadLen);
+	return max < 1 ? 1 : max;
+}
+
+/*	fmacSend has room for a packet. The queue is one framelet deep: false
+ *	once a framelet waits for the current sequence to finish, until the timer
+ *	interrupt starts it.
+ */
+inline static bool fmacCanSend (const fmacCtx * const fm) {
+	return !fm->txNext;
+}
+
+/*	Packets are waiting for txcb, fetch them from fmacProcess. Safe to call
+ *	from any interrupt.
+ */
+inline static void fmacPoll (fmacCtx * const fm) {
+	fm->txPoll = true;
+}
 
-inline static bool fmacCanSend (fmacCtx * const fm) {
-	return fm->state == FMAC_IDLE;
+/*	Received framelets or a poll waiting for fmacProcess
+ */
+inline static bool fmacPending (const fmacCtx * const fm) {
+	return fm->rxHead != fm->rxTail || fm->txPoll;
 }
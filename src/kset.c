@@ -0,0 +1,198 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*	Search for f-MAC k-sets
+ *
+ *	Station i repeats its framelet n times, t_i=k_i*δ apart. With δ=2d two
+ *	framelets overlap only if their start times are less than one δ apart, so
+ *	the sequences of stations i and j collide at most as often as
+ *	m*k_i-l*k_j=v has solutions for 0≤m,l<n. If k_i and k_j are coprime these
+ *	solutions are k_j apart in m and k_i apart in l, i.e. there is at most one
+ *	unless both k_i<n and k_j<n. Every other station destroys at most one
+ *	framelet then and at least one of the n repetitions arrives.
+ *
+ *	As in the paper k=1 is not used. Among the valid sets the one with the
+ *	smallest kmax is optimal, since it determines the wait t' and thus the
+ *	cycle length. Ties are broken by the smallest sum, which reproduces the
+ *	sets given in the paper. The exhaustive search becomes too slow for the
+ *	microcontroller at about n=20, so it is run offline (host/ksetgen) and
+ *	the firmware falls back to a greedy search for larger cells.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+
+#include "kset.h"
+
+/* give up after this, the sets found for n≤KSET_MAX_N stay well below */
+#define KMAX_LIMIT (1024)
+
+static uint32_t gcd (uint32_t a, uint32_t b) {
+	while (b != 0) {
+		const uint32_t t = a%b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+uint32_t ksetMax (const uint32_t * const k, const uint8_t n) {
+	uint32_t kmax = 0;
+	for (uint8_t j = 0; j < n; j++) {
+		kmax = k[j] > kmax ? k[j] : kmax;
+	}
+	return kmax;
+}
+
+/*	Check k-set for n stations is collision-free
+ */
+bool ksetValid (const uint32_t * const k, const uint8_t n) {
+	for (uint8_t a = 0; a < n; a++) {
+		if (k[a] < 2) {
+			return false;
+		}
+		for (uint8_t b = a+1; b < n; b++) {
+			if (gcd (k[a], k[b]) != 1 || (k[a] < n && k[b] < n)) {
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+typedef struct {
+	/* set under construction, kmax is always the last element */
+	uint32_t cur[KSET_MAX_N];
+	uint8_t n;
+	bool found;
+	uint32_t best[KSET_MAX_N], bestSum;
+} searchCtx;
+
+static bool coprimeToAll (const searchCtx * const s, const uint8_t depth,
+		const uint32_t c) {
+	if (gcd (c, s->cur[s->n-1]) != 1) {
+		return false;
+	}
+	for (uint8_t j = 0; j < depth; j++) {
+		if (gcd (c, s->cur[j]) != 1) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*	Pick elements in ascending order, starting at next
+ */
+static void search (searchCtx * const s, const uint8_t depth,
+		const uint32_t next, const uint32_t sum) {
+	const uint32_t kmax = s->cur[s->n-1];
+	const uint8_t remaining = s->n-1-depth;
+
+	if (remaining == 0) {
+		if (!s->found || sum < s->bestSum) {
+			for (uint8_t j = 0; j < s->n; j++) {
+				s->best[j] = s->cur[j];
+			}
+			s->bestSum = sum;
+			s->found = true;
+		}
+		return;
+	}
+
+	for (uint32_t c = next; c < kmax; c++) {
+		/* not enough candidates left */
+		if (kmax-c < remaining) {
+			break;
+		}
+		/* the remaining elements add at least c+(c+1)+… */
+		if (s->found && sum + remaining*c + remaining*(remaining-1)/2 >= s->bestSum) {
+			break;
+		}
+		/* ascending order, so only the first one may be small */
+		if (c < s->n && (depth > 0 || kmax < s->n)) {
+			c = s->n-1;
+			continue;
+		}
+		if (!coprimeToAll (s, depth, c)) {
+			continue;
+		}
+		s->cur[depth] = c;
+		search (s, depth+1, c+1, sum+c);
+	}
+}
+
+/*	Find optimal collision-free k-set for n stations, sorted ascending
+ */
+bool ksetFind (uint32_t * const k, const uint8_t n) {
+	assert (k != NULL);
+
+	if (n == 0 || n > KSET_MAX_N) {
+		return false;
+	}
+
+	searchCtx s = { .n = n, .found = false };
+	for (uint32_t kmax = 2; kmax < KMAX_LIMIT && !s.found; kmax++) {
+		s.cur[n-1] = kmax;
+		search (&s, 0, 2, kmax);
+	}
+	if (!s.found) {
+		return false;
+	}
+
+	for (uint8_t j = 0; j < n; j++) {
+		k[j] = s.best[j];
+	}
+	assert (ksetValid (k, n));
+	return true;
+}
+
+/*	Quickly find a collision-free, but not necessarily optimal k-set by
+ *	picking the smallest usable numbers
+ */
+bool ksetGreedy (uint32_t * const k, const uint8_t n) {
+	assert (k != NULL);
+
+	if (n == 0 || n > KSET_MAX_N) {
+		return false;
+	}
+
+	uint8_t have = 0;
+	for (uint32_t c = 2; c < KMAX_LIMIT && have < n; c++) {
+		/* only one of them may be smaller than n */
+		if (c < n && have > 0) {
+			continue;
+		}
+		bool coprime = true;
+		for (uint8_t j = 0; j < have && coprime; j++) {
+			coprime = gcd (c, k[j]) == 1;
+		}
+		if (coprime) {
+			k[have++] = c;
+		}
+	}
+	if (have < n) {
+		return false;
+	}
+
+	assert (ksetValid (k, n));
+	return true;
+}
@@ -0,0 +1,46 @@
+/* generated by host/ksetgen, do not edit */
+
+#pragma once
+
+#include <stdint.h>
+
+#define KSET_TABLE_MAX_N (16)
+
+/* collision-free k-sets with minimal kmax, see kset.c */
+static const uint32_t ksetTable[] = {
+	2, /* n=1 */
+	2, 3, /* n=2 */
+	2, 3, 5, /* n=3 */
+	3, 4, 5, 7, /* n=4 */
+	2, 5, 7, 9, 11, /* n=5 */
+	5, 7, 8, 9, 11, 13, /* n=6 */
+	5, 7, 8, 9, 11, 13, 17, /* n=7 */
+	5, 8, 9, 11, 13, 17, 19, 23, /* n=8 */
+	7, 9, 11, 13, 16, 17, 19, 23, 25, /* n=9 */
+	7, 11, 13, 16, 17, 19, 23, 25, 27, 29, /* n=10 */
+	7, 11, 13, 16, 17, 19, 23, 25, 27, 29, 31, /* n=11 */
+	11, 13, 16, 17, 19, 21, 23, 25, 29, 31, 37, 41, /* n=12 */
+	11, 13, 16, 17, 19, 21, 23, 25, 29, 31, 37, 41, 43, /* n=13 */
+	11, 16, 17, 19, 23, 25, 27, 29, 31, 37, 41, 43, 47, 49, /* n=14 */
+	11, 16, 17, 19, 23, 25, 27, 29, 31, 37, 41, 43, 47, 49, 53, /* n=15 */
+	11, 16, 17, 19, 23, 25, 27, 29, 31, 37, 41, 43, 47, 49, 53, 59, /* n=16 */
+	};
+static const uint16_t ksetTableOff[] = {
+	0, /* unused */
+	0, /* n=1 */
+	1, /* n=2 */
+	3, /* n=3 */
+	6, /* n=4 */
+	10, /* n=5 */
+	15, /* n=6 */
+	21, /* n=7 */
+	28, /* n=8 */
+	36, /* n=9 */
+	45, /* n=10 */
+	55, /* n=11 */
+	66, /* n=12 */
+	78, /* n=13 */
+	91, /* n=14 */
+	105, /* n=15 */
+	120, /* n=16 */
+	};
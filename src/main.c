@@ -35,6 +35,7 @@ THE SOFTWARE.
 #include "config.h"
 #include "util.h"
 #include "spiclient.h"
+#include "timer.h"
 
 static tda5340Ctx tda0;
 static fmacCtx fm;
@@ -47,7 +48,7 @@ void TDA5350IRQHANDLER (void) {
 }
 
 void CCU40_0_IRQHandler(void) {
-	fmacIrqHandle (&fm);
+	timerIrqHandle ();
 }
 
 /* Setup clock, called by SystemInit
@@ -86,28 +87,54 @@ void SystemCoreClockSetup () {
 }
 
 /* 	glue between fmac and spiclient */
-/*	init fmac */
+/*	init fmac, called from the main loop, see spiclientProcess */
 static void initMac (void *data, const uint8_t i, const uint8_t n,
-		const uint8_t payloadSize) {
+		const uint8_t payloadSize, const uint8_t train, const uint8_t encoder) {
 	assert (data != NULL);
 	assert (i < n);
 
 	fmacCtx * const fm = data;
-	fmacInit (fm, i, n, &tda0, payloadSize);
+	fmacInit (fm, i, n, &tda0, payloadSize, train, encoder);
 }
 
-/*	trigger tx callback */
+/*	host queued packets, fetched by the main loop */
 static void triggerSend (void *data) {
 	assert (data != NULL);
 
 	fmacCtx * const fm = data;
-	if (fmacCanSend (fm) && fm->txcb != NULL) {
-		const void *data;
-		size_t size;
-		if (fm->txcb (fm->cbdata, &data, &size)) {
-			fmacSend (fm, data, size);
-		}
-	}
+	fmacPoll (fm);
+}
+
+/*	set multicast group membership */
+static void setGroups (void *data, const uint32_t groups) {
+	assert (data != NULL);
+
+	fmacCtx * const fm = data;
+	fm->groups = groups;
+}
+
+/*	read guard time calibration */
+static void getTiming (void *data, fmacTiming * const t) {
+	assert (data != NULL);
+
+	const fmacCtx * const fm = data;
+	fmacGetTiming (fm, t);
+}
+
+/*	override guard time */
+static void setDelta (void *data, const uint32_t us) {
+	assert (data != NULL);
+
+	fmacCtx * const fm = data;
+	fmacSetDelta (fm, us);
+}
+
+/*	read clock skew of station */
+static bool getSkew (void *data, const uint8_t station, int32_t * const ppm) {
+	assert (data != NULL);
+
+	const fmacCtx * const fm = data;
+	return fmacGetSkew (fm, station, ppm);
 }
 
 int main() {
@@ -142,6 +169,11 @@ int main() {
 	/* wait until the tda is ready */
 	while (tda0.mode != TDA_SLEEP_MODE);
 
+	/* shared by fmac and spiclient */
+	const uint32_t schedPriority = NVIC_EncodePriority (
+			NVIC_GetPriorityGrouping(), PRIO_SCHED_PREEMPT, PRIO_SCHED_SUB);
+	timerInit (schedPriority);
+
 	const uint32_t spiPriority =
 			NVIC_EncodePriority (NVIC_GetPriorityGrouping(), PRIO_SPI_PREEMPT,
 			PRIO_SPI_SUB);
@@ -153,12 +185,26 @@ int main() {
 	fm.txcb = spiclientTx;
 	spi.initMac = initMac;
 	spi.triggerSend = triggerSend;
+	spi.setGroups = setGroups;
+	spi.getTiming = getTiming;
+	spi.setDelta = setDelta;
+	spi.getSkew = getSkew;
 	spi.macData = &fm;
 
 #if defined(DEBUG_STATIONID) && defined(DEBUG_NUMSTATIONS)
-	initMac (&fm, DEBUG_STATIONID, DEBUG_NUMSTATIONS, 16);
+	initMac (&fm, DEBUG_STATIONID, DEBUG_NUMSTATIONS, 16, 1, PACKET_ENCODER);
 #endif
 
-	while (1);
+	while (1) {
+		/* wfi wakes up on pending interrupts even if they are masked, so
+		 * nothing queued in between is missed */
+		__disable_irq ();
+		if (!fmacPending (&fm) && !spiclientPending (&spi)) {
+			__WFI ();
+		}
+		__enable_irq ();
+		spiclientProcess (&spi);
+		fmacProcess (&fm);
+	}
 }
 
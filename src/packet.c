@@ -28,7 +28,10 @@ THE SOFTWARE.
 #include "packet.h"
 #include "config.h"
 #include "crc32.h"
+#include "crc16.h"
+#include "crc8.h"
 #include "fmac.h"
+#include "rs.h"
 
 /* packet specifics, XXX length is still hardcoded in a lot of places */
 /* 8 bit runin, 16 bit tsi */
@@ -39,97 +42,409 @@ THE SOFTWARE.
 #define TRAILING_ZEROS (8)
 #define TRAILING_ZEROS_BYTES ((TRAILING_ZEROS-1)/8+1)
 
+/* ===== checksum ===== */
+
+/* bytes of crc at the end of every message, see PACKET_CRC_BITS */
+#define CRC_LEN (PACKET_CRC_BITS/8)
+#if PACKET_CRC_BITS != 8 && PACKET_CRC_BITS != 16 && PACKET_CRC_BITS != 32
+#error "unsupported crc width"
+#endif
+
+/*	Append b to crc, zero is the initial value
+ */
+static inline uint32_t crcByte (const uint32_t crc, const uint8_t b) {
+#if PACKET_CRC_BITS == 32
+	return crc32Byte (crc, b);
+#elif PACKET_CRC_BITS == 16
+	return crc16Byte (crc, b);
+#else
+	return crc8Byte (crc, b);
+#endif
+}
+
+/*	crc of len bytes, zero if buf ends with a matching crc
+ */
+static uint32_t crcCalc (const uint8_t * const buf, const size_t len) {
+#if PACKET_CRC_BITS == 32
+	return crc32Calc ((const uint32_t *) buf, len);
+#elif PACKET_CRC_BITS == 16
+	return crc16Calc (buf, len);
+#else
+	return crc8Calc (buf, len);
+#endif
+}
+
+/*	Store crc little endian, which makes the remainder zero
+ */
+static void crcPut (uint8_t * const dest, const uint32_t crc) {
+	for (unsigned int i = 0; i < CRC_LEN; i++) {
+		dest[i] = crc >> (i*8);
+	}
+}
+
+/*	Init correction tables of the selected crc
+ */
+void packetCrcInit (void) {
+#if PACKET_CRC_BITS == 32
+	crc32Init (CRC32_MAX_MSGLEN);
+#elif PACKET_CRC_BITS == 16
+	crc16Init (CRC16_MAX_MSGLEN);
+#else
+	crc8Init (CRC8_MAX_MSGLEN);
+#endif
+}
+
+/*	Correct errors in buf (len bytes including crc), given its crc remainder,
+ *	see crc32Correct. crc16 and crc8 only correct single bit errors.
+ */
+static packetDecodeStatus correctCrc (uint8_t * const buf, const size_t len,
+		uint32_t crc) {
+	if (crc != 0) {
+#if PACKET_CRC_BITS == 32
+		const crc32Correction c = crc32Correct (buf, len, crc);
+		const bool corrected = c != CRC32_UNCORRECTABLE;
+#elif PACKET_CRC_BITS == 16
+		const unsigned int c = 1;
+		const bool corrected = crc16Correct (buf, len, crc);
+#elif defined(CRC8_CORRECT)
+		const unsigned int c = 1;
+		const bool corrected = crc8Correct (buf, len, crc);
+#else
+		const unsigned int c = 0;
+		const bool corrected = false;
+#endif
+		if (corrected) {
+			SEGGER_RTT_printf (0, "crc mismatch %x, corrected (%u)\n", crc, c);
+			/* try again, XXX: is this required or can we just assume the
+			 * packet is now correct? */
+			crc = crcCalc (buf, len);
+			if (crc != 0) {
+				SEGGER_RTT_printf (0, "miscorrected crc error\n");
+				return PACKET_DECODE_ECC_FAIL;
+			}
+		} else {
+			SEGGER_RTT_printf (0, "uncorrectable n bit crc error\n");
+			return PACKET_DECODE_CHECKSUM_FAIL;
+		}
+	}
+	return PACKET_DECODE_OK;
+}
+
+/*	Check crc at the end of buf (len bytes including crc) and correct
+ *	errors
+ */
+static packetDecodeStatus checkCrc (uint8_t * const buf, const size_t len) {
+	return correctCrc (buf, len, crcCalc (buf, len));
+}
+
 /* ===== 8b10b ===== */
 
+/*	Unencoded message length for payloadLen: length byte, payload and crc.
+ *	Padded before the crc so the encoded message ends on a byte boundary.
+ */
+static size_t packet8b10bRawLen (const size_t payloadLen) {
+	return (1+payloadLen+CRC_LEN+3)/4*4;
+}
+
+/* 5b6b and 3b4b sub-blocks for negative (0) and positive (1) running
+ * disparity, first transmitted bit in bit 0 like dottedline’s encoder */
+static const uint8_t code5b6b[2][32] = {
+	{0x39, 0x2e, 0x2d, 0x23, 0x2b, 0x25, 0x26, 0x07,
+	0x27, 0x29, 0x2a, 0x0b, 0x2c, 0x0d, 0x0e, 0x3a,
+	0x36, 0x31, 0x32, 0x13, 0x34, 0x15, 0x16, 0x17,
+	0x33, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x35},
+	{0x06, 0x11, 0x12, 0x23, 0x14, 0x25, 0x26, 0x38,
+	0x18, 0x29, 0x2a, 0x0b, 0x2c, 0x0d, 0x0e, 0x05,
+	0x09, 0x31, 0x32, 0x13, 0x34, 0x15, 0x16, 0x28,
+	0x0c, 0x19, 0x1a, 0x24, 0x1c, 0x22, 0x21, 0x0a},
+	};
+static const uint8_t code3b4b[2][8] = {
+	{0x0d, 0x09, 0x0a, 0x03, 0x0b, 0x05, 0x06, 0x07},
+	{0x02, 0x09, 0x0a, 0x0c, 0x04, 0x05, 0x06, 0x08},
+	};
+/* D.x.A7, avoids runs of five equal bits */
+static const uint8_t code3b4bAlt[2] = {0x0e, 0x01};
+
+/* 10 bit symbol for every byte and running disparity, bit 10 is set if the
+ * symbol flips the running disparity */
+static uint16_t eightbtenbTable[2][256];
+/* inverse of the sub-blocks, -1 for invalid codes */
+static int8_t decode6b5b[64], decode4b3b[16];
+
+static void eightbtenbTableInit (void) {
+	memset (decode6b5b, -1, sizeof (decode6b5b));
+	memset (decode4b3b, -1, sizeof (decode4b3b));
+	for (unsigned int rd = 0; rd < 2; rd++) {
+		for (unsigned int x = 0; x < 32; x++) {
+			decode6b5b[code5b6b[rd][x]] = x;
+		}
+		for (unsigned int y = 0; y < 8; y++) {
+			decode4b3b[code3b4b[rd][y]] = y;
+		}
+		decode4b3b[code3b4bAlt[rd]] = 7;
+	}
+
+	for (unsigned int rd = 0; rd < 2; rd++) {
+		for (unsigned int b = 0; b < 256; b++) {
+			const unsigned int x = b & 0x1f, y = b >> 5;
+			unsigned int r = rd;
+			const uint8_t six = code5b6b[r][x];
+			r ^= __builtin_popcount (six) != 3;
+			uint8_t four;
+			if (y == 7 && ((r == 0 && (x == 17 || x == 18 || x == 20)) ||
+					(r == 1 && (x == 11 || x == 13 || x == 14)))) {
+				four = code3b4bAlt[r];
+			} else {
+				four = code3b4b[r][y];
+			}
+			r ^= __builtin_popcount (four) != 2;
+			eightbtenbTable[rd][b] = six | (four << 6) | ((r ^ rd) << 10);
+		}
+	}
+}
+
+/* output state of the fused encoder */
+typedef struct {
+	uint8_t *dest;
+	/* bits not written to dest yet, less than eight between symbols */
+	uint32_t bits;
+	unsigned int pending, rd;
+} eightbtenbStream;
+
+static inline void eightbtenbPut (eightbtenbStream * const s, const uint8_t b) {
+	const uint16_t sym = eightbtenbTable[s->rd][b];
+	s->rd ^= sym >> 10;
+	s->bits |= (uint32_t) (sym & 0x3ff) << s->pending;
+	s->pending += 10;
+	while (s->pending >= 8) {
+		*s->dest++ = s->bits;
+		s->bits >>= 8;
+		s->pending -= 8;
+	}
+}
+
+/*	Runs the crc and the 8b10b encoder in a single pass over length byte,
+ *	payload and padding, writing symbols straight into dest. Called from
+ *	fmacSend, i.e. interrupt context.
+ */
 static size_t packet8b10bEncode (const uint8_t * const src, const size_t srcLen,
 		uint8_t * const dest, const size_t destLen) {
 	assert (src != NULL);
-	assert (srcLen > 0);
+	assert (srcLen > 0 && srcLen <= UINT8_MAX);
 	assert (dest != NULL);
 
+	const size_t rawSize = packet8b10bRawLen (srcLen);
+	const size_t bodySize = rawSize - CRC_LEN;
+	const size_t encodedSizeBits = rawSize*10;
+	assert (encodedSizeBits%8 == 0);
+	const size_t encodedSizeBytes = encodedSizeBits/8;
+	assert (PREAMBLE+encodedSizeBytes+TRAILING_ZEROS_BYTES <= destLen);
+
 	dest[0] = 0xaa;
 	dest[1] = 0x9a;
 	dest[2] = 0x69;
 
-	const uint32_t crc32 = crc32Calc ((const uint32_t * const) src, srcLen);
-
-	/* XXX: we could save this memcpy if eightbtenbEncode handles multiple
-	 * calls well */
-	uint8_t raw[FMAC_MAX_PACKET_LEN];
-	const size_t rawSize = srcLen + sizeof (crc32);
-	assert (rawSize <= sizeof (raw));
-	memcpy (raw, src, srcLen);
-	memcpy (&raw[srcLen], &crc32, sizeof (crc32));
-
-	const size_t encodedSizeBits = rawSize*10;
-	assert (encodedSizeBits%8 == 0);
-	const size_t encodedSizeBytes = encodedSizeBits/8;
-	eightbtenbCtx linecode;
-	eightbtenbInit (&linecode);
-	eightbtenbSetDest (&linecode, &dest[PREAMBLE]);
-	eightbtenbEncode (&linecode, raw, rawSize);
+	eightbtenbStream out = {.dest = &dest[PREAMBLE], .bits = 0, .pending = 0,
+			.rd = 0};
+	uint32_t crc = crcByte (0, srcLen);
+	eightbtenbPut (&out, srcLen);
+	for (size_t i = 0; i < srcLen; i++) {
+		crc = crcByte (crc, src[i]);
+		eightbtenbPut (&out, src[i]);
+	}
+	for (size_t i = 1+srcLen; i < bodySize; i++) {
+		crc = crcByte (crc, 0);
+		eightbtenbPut (&out, 0);
+	}
+	for (unsigned int i = 0; i < CRC_LEN; i++) {
+		eightbtenbPut (&out, crc >> (i*8));
+	}
+	assert (out.pending == 0);
 
 	memset (&dest[PREAMBLE+encodedSizeBytes], 0, TRAILING_ZEROS_BYTES);
 
-	const size_t s = PREAMBLE*8+encodedSizeBits+TRAILING_ZEROS;
-
-	return s;
+	return PREAMBLE*8+encodedSizeBits+TRAILING_ZEROS;
 }
 
+/*	The tda stops receiving on sync loss or after the max length, so srcBits
+ *	may include noise after the actual packet. Its length is taken from the
+ *	first symbol.
+ */
 static packetDecodeStatus packet8b10bDecode (const uint8_t * const src,
-		const size_t srcBits, uint8_t * const dest, const size_t destLen) {
+		const size_t srcBits, uint8_t * const dest, const size_t destLen,
+		size_t * const payloadLen) {
+	eightbtenbCtx linecode;
+
+	if (srcBits < 10) {
+		SEGGER_RTT_printf (0, "packet len fail, %u\n", srcBits);
+		return PACKET_DECODE_LINECODE_FAIL;
+	}
+	eightbtenbInit (&linecode);
+	eightbtenbSetDest (&linecode, dest);
+	if (!eightbtenbDecode (&linecode, src, 10)) {
+		SEGGER_RTT_printf (0, "8b10b fail\n");
+		return PACKET_DECODE_LINECODE_FAIL;
+	}
+
 	/* 8b10b decoder expects full symbols, packet must be large enough to carry
 	 * crc */
-	if (srcBits % 10 != 0 || srcBits <= 40) {
-		SEGGER_RTT_printf (0, "packet len fail, %u\n", srcBits);
+	const size_t len = dest[0];
+	const size_t rawLen = packet8b10bRawLen (len);
+	if (len == 0 || rawLen*10 > srcBits || rawLen > destLen) {
+		SEGGER_RTT_printf (0, "packet len fail, %u, %u\n", srcBits, len);
 		return PACKET_DECODE_LINECODE_FAIL;
 	}
 
-	eightbtenbCtx linecode;
 	eightbtenbInit (&linecode);
 	eightbtenbSetDest (&linecode, dest);
-	if (!eightbtenbDecode (&linecode, src, srcBits)) {
+	if (!eightbtenbDecode (&linecode, src, rawLen*10)) {
 		SEGGER_RTT_printf (0, "8b10b fail\n");
 		return PACKET_DECODE_LINECODE_FAIL;
 	}
 
-	/* check crc32 at end of packet */
-	uint32_t crc32 = crc32Calc ((uint32_t *) dest, srcBits/8-4);
-	if (crc32 != 0) {
-		const unsigned int incorrect = crc32IncorrectBit (crc32);
-		if (incorrect != -1) {
-			SEGGER_RTT_printf (0, "crc mismatch %x, bit %u incorrect\n", crc32, incorrect);
-			/* correct that bit */
-			dest[incorrect/8] ^= (1<<(incorrect%8));
-			/* try again, XXX: is this required or can we just assume the
-			 * packet is now correct? */
-			crc32 = crc32Calc ((uint32_t *) dest, srcBits/8-4);
-			if (crc32 != 0) {
-				SEGGER_RTT_printf (0, "uncorrectable 1 bit crc error\n");
-				return PACKET_DECODE_ECC_FAIL;
+	const packetDecodeStatus ret = checkCrc (dest, rawLen);
+	if (ret != PACKET_DECODE_OK) {
+		return ret;
+	}
+
+	/* strip length byte, which may have been corrected */
+	if (dest[0] == 0 || packet8b10bRawLen (dest[0]) != rawLen) {
+		SEGGER_RTT_printf (0, "length miscorrected\n");
+		return PACKET_DECODE_ECC_FAIL;
+	}
+	*payloadLen = dest[0];
+	memmove (dest, &dest[1], *payloadLen);
+
+	return PACKET_DECODE_OK;
+}
+
+/*	Decode symbols following the length symbol. Symbols start at even bit
+ *	offsets, so each one spans at most two bytes.
+ */
+static bool packet8b10bPeek (const uint8_t * const src, const size_t srcBits,
+		uint8_t * const dest, const size_t len) {
+	if ((1+len)*10 > srcBits) {
+		return false;
+	}
+	for (size_t i = 0; i < len; i++) {
+		const size_t bit = (1+i)*10;
+		const unsigned int b = src[bit/8] | (src[bit/8+1] << 8);
+		const unsigned int sym = (b >> (bit%8)) & 0x3ff;
+		const int x = decode6b5b[sym & 0x3f], y = decode4b3b[sym >> 6];
+		if (x == -1 || y == -1) {
+			return false;
+		}
+		dest[i] = x | (y << 5);
+	}
+	return true;
+}
+
+/*	Streaming decoder, runs 8b10b and the crc on every block read from the tda’s
+ *	fifo. The length byte is kept in the state, so dest only receives the
+ *	payload and nothing needs to be moved at the end.
+ */
+static void packet8b10bStreamBegin (packetStream * const s,
+		uint8_t * const dest, const size_t destLen) {
+	s->dest = dest;
+	s->destLen = destLen;
+	s->bits = 0;
+	s->pending = 0;
+	s->pos = 0;
+	s->rawLen = 0;
+	s->crc = 0;
+	s->status = PACKET_DECODE_OK;
+}
+
+static void packet8b10bStreamPush (packetStream * const s,
+		const uint32_t block, const uint8_t bits) {
+	assert (bits <= 32);
+	if (s->status != PACKET_DECODE_OK || (s->rawLen != 0 && s->pos == s->rawLen)) {
+		/* failed or complete, ignore noise after the packet */
+		return;
+	}
+	s->bits |= (uint64_t) block << s->pending;
+	s->pending += bits;
+
+	while (s->pending >= 10) {
+		const unsigned int sym = s->bits & 0x3ff;
+		s->bits >>= 10;
+		s->pending -= 10;
+		const int x = decode6b5b[sym & 0x3f], y = decode4b3b[sym >> 6];
+		if (x == -1 || y == -1) {
+			s->status = PACKET_DECODE_LINECODE_FAIL;
+			return;
+		}
+		const uint8_t b = x | (y << 5);
+		s->crc = crcByte (s->crc, b);
+		if (s->pos == 0) {
+			s->len = b;
+			s->rawLen = packet8b10bRawLen (b);
+			if (b == 0 || s->rawLen > s->destLen) {
+				s->status = PACKET_DECODE_LINECODE_FAIL;
+				return;
 			}
 		} else {
-			SEGGER_RTT_printf (0, "uncorrectable n bit crc error\n");
-			return PACKET_DECODE_CHECKSUM_FAIL;
+			s->dest[s->pos-1] = b;
+		}
+		++s->pos;
+		if (s->pos == s->rawLen) {
+			return;
+		}
+	}
+}
+
+/*	Only the crc is left to check, unless there are errors to correct
+ */
+static packetDecodeStatus packet8b10bStreamEnd (packetStream * const s,
+		size_t * const payloadLen) {
+	if (s->status != PACKET_DECODE_OK) {
+		SEGGER_RTT_printf (0, "8b10b fail\n");
+		return s->status;
+	}
+	if (s->rawLen == 0 || s->pos < s->rawLen) {
+		SEGGER_RTT_printf (0, "packet len fail, %u, %u\n", s->pos, s->len);
+		return PACKET_DECODE_LINECODE_FAIL;
+	}
+
+	if (s->crc != 0) {
+		/* correction expects the whole message */
+		memmove (&s->dest[1], s->dest, s->rawLen-1);
+		s->dest[0] = s->len;
+		const packetDecodeStatus ret = correctCrc (s->dest, s->rawLen, s->crc);
+		if (ret != PACKET_DECODE_OK) {
+			return ret;
+		}
+		/* the length byte may have been corrected as well */
+		if (s->dest[0] == 0 || packet8b10bRawLen (s->dest[0]) != s->rawLen) {
+			SEGGER_RTT_printf (0, "length miscorrected\n");
+			return PACKET_DECODE_ECC_FAIL;
 		}
+		s->len = s->dest[0];
+		memmove (s->dest, &s->dest[1], s->len);
 	}
+	*payloadLen = s->len;
 
 	return PACKET_DECODE_OK;
 }
 
 static size_t packet8b10bTxLen (const size_t payloadLen) {
-	return PREAMBLE+(payloadLen+4)*10/8+TRAILING_ZEROS_BYTES;
+	return PREAMBLE+packet8b10bRawLen (payloadLen)*10/8+TRAILING_ZEROS_BYTES;
 }
 
 static size_t packet8b10bRxLen (const size_t payloadLen) {
-	return (payloadLen+4)*10;
+	return packet8b10bRawLen (payloadLen)*10;
 }
 
 void packet8b10bInit (packetEncoder * const enc) {
+	eightbtenbTableInit ();
 	enc->encode = packet8b10bEncode;
 	enc->decode = packet8b10bDecode;
 	enc->txlen = packet8b10bTxLen;
 	enc->rxlen = packet8b10bRxLen;
+	enc->peek = packet8b10bPeek;
+	enc->streamBegin = packet8b10bStreamBegin;
+	enc->streamPush = packet8b10bStreamPush;
+	enc->streamEnd = packet8b10bStreamEnd;
 }
 
 /* ===== identity ===== */
@@ -137,65 +452,77 @@ void packet8b10bInit (packetEncoder * const enc) {
 static size_t identityEncode (const uint8_t * const src, const size_t srcLen,
 		uint8_t * const dest, const size_t destLen) {
 	assert (src != NULL);
-	assert (srcLen > 0);
+	assert (srcLen > 0 && srcLen <= UINT8_MAX);
 	assert (dest != NULL);
+	assert (PREAMBLE+1+srcLen+CRC_LEN+TRAILING_ZEROS_BYTES <= destLen);
 
 	dest[0] = 0xaa;
 	dest[1] = 0x9a;
 	dest[2] = 0x69;
 
-	const uint32_t crc32 = crc32Calc ((const uint32_t * const) src, srcLen);
+	uint8_t * const raw = &dest[PREAMBLE];
+	raw[0] = srcLen;
+	memcpy (&raw[1], src, srcLen);
+	crcPut (&raw[1+srcLen], crcCalc (raw, 1+srcLen));
+	memset (&raw[1+srcLen+CRC_LEN], 0, TRAILING_ZEROS_BYTES);
 
-	memcpy (&dest[PREAMBLE], src, srcLen);
-	memcpy (&dest[PREAMBLE+srcLen], &crc32, sizeof (crc32));
-	memset (&dest[PREAMBLE+srcLen+sizeof (crc32)], 0, TRAILING_ZEROS_BYTES);
-
-	const size_t s = PREAMBLE*8+srcLen*8+sizeof (crc32)*8+TRAILING_ZEROS;
+	const size_t s = PREAMBLE*8+(1+srcLen+CRC_LEN)*8+TRAILING_ZEROS;
 
 	return s;
 }
 
 static packetDecodeStatus identityDecode (const uint8_t * const src,
-		const size_t srcBits, uint8_t * const dest, const size_t destLen) {
-	/* expects full bytes */
-	if (srcBits % 8 != 0 || srcBits <= 32) {
+		const size_t srcBits, uint8_t * const dest, const size_t destLen,
+		size_t * const payloadLen) {
+	/* first byte is the payload length */
+	const size_t len = srcBits >= 8 ? src[0] : 0;
+	const size_t rawLen = 1+len+CRC_LEN;
+	if (len == 0 || rawLen*8 > srcBits || rawLen > destLen) {
 		SEGGER_RTT_printf (0, "packet len fail, %u\n", srcBits);
 		return PACKET_DECODE_LINECODE_FAIL;
 	}
 
-	/* check crc32 at end of packet */
-	uint32_t crc32 = crc32Calc ((uint32_t *) dest, srcBits/8-4);
-	if (crc32 != 0) {
-		const unsigned int incorrect = crc32IncorrectBit (crc32);
-		if (incorrect != -1) {
-			SEGGER_RTT_printf (0, "crc mismatch %x, bit %u incorrect\n", crc32, incorrect);
-			/* correct that bit */
-			dest[incorrect/8] ^= (1<<(incorrect%8));
-			/* try again, XXX: is this required or can we just assume the
-			 * packet is now correct? */
-			crc32 = crc32Calc ((uint32_t *) dest, srcBits/8-4);
-			if (crc32 != 0) {
-				SEGGER_RTT_printf (0, "uncorrectable 1 bit crc error\n");
-				return PACKET_DECODE_ECC_FAIL;
-			}
-		} else {
-			SEGGER_RTT_printf (0, "uncorrectable n bit crc error\n");
-			return PACKET_DECODE_CHECKSUM_FAIL;
-		}
+	/* check the crc on the received buffer, only a corrupted framelet needs
+	 * a writable copy for correction */
+	const uint32_t crc = crcCalc (src, rawLen);
+	if (crc == 0) {
+		*payloadLen = len;
+		memcpy (dest, &src[1], len);
+		return PACKET_DECODE_OK;
+	}
+
+	memcpy (dest, src, rawLen);
+	const packetDecodeStatus ret = correctCrc (dest, rawLen, crc);
+	if (ret != PACKET_DECODE_OK) {
+		return ret;
 	}
 
-	assert (srcBits/8-4 <= destLen);
-	memcpy (dest, src, srcBits/8-4);
+	/* strip length byte, which may have been corrected */
+	if (dest[0] != len) {
+		SEGGER_RTT_printf (0, "length miscorrected\n");
+		return PACKET_DECODE_ECC_FAIL;
+	}
+	*payloadLen = dest[0];
+	memmove (dest, &dest[1], *payloadLen);
 
 	return PACKET_DECODE_OK;
 }
 
+static bool identityPeek (const uint8_t * const src, const size_t srcBits,
+		uint8_t * const dest, const size_t len) {
+	if ((1+len)*8 > srcBits) {
+		return false;
+	}
+	memcpy (dest, &src[1], len);
+	return true;
+}
+
 static size_t identityTxLen (const size_t payloadLen) {
-	return PREAMBLE+payloadLen+4+TRAILING_ZEROS_BYTES;
+	return PREAMBLE+1+payloadLen+CRC_LEN+TRAILING_ZEROS_BYTES;
 }
 
 static size_t identityRxLen (const size_t payloadLen) {
-	return (payloadLen+4)*8;
+	return (1+payloadLen+CRC_LEN)*8;
 }
 
 void packetIdentityInit (packetEncoder * const enc) {
@@ -203,4 +530,455 @@ void packetIdentityInit (packetEncoder * const enc) {
 	enc->decode = identityDecode;
 	enc->txlen = identityTxLen;
 	enc->rxlen = identityRxLen;
+	enc->peek = identityPeek;
+	enc->streamBegin = NULL;
+	enc->streamPush = NULL;
+	enc->streamEnd = NULL;
+}
+
+/* ===== scrambled nrz ===== */
+
+/* pn9 sequence (x^9+x^5+1, seed 0x1ff), XORed onto the message. The tsi
+ * already synchronizes the receiver, so unlike a self-synchronizing
+ * scrambler this does not multiply bit errors */
+static uint8_t whitening[FMAC_MAX_PACKET_LEN];
+
+static void whiteningInit (void) {
+	unsigned int state = 0x1ff;
+	for (unsigned int i = 0; i < sizeof (whitening); i++) {
+		uint8_t b = 0;
+		for (unsigned int j = 0; j < 8; j++) {
+			b |= (state & 1) << j;
+			const unsigned int feedback = (state ^ (state >> 5)) & 1;
+			state = (state >> 1) | (feedback << 8);
+		}
+		whitening[i] = b;
+	}
+}
+
+static size_t scrambledEncode (const uint8_t * const src, const size_t srcLen,
+		uint8_t * const dest, const size_t destLen) {
+	assert (src != NULL);
+	assert (srcLen > 0 && srcLen <= UINT8_MAX);
+	assert (dest != NULL);
+	const size_t rawLen = 1+srcLen+CRC_LEN;
+	assert (PREAMBLE+rawLen+TRAILING_ZEROS_BYTES <= destLen);
+
+	dest[0] = 0xaa;
+	dest[1] = 0x9a;
+	dest[2] = 0x69;
+
+	uint8_t * const raw = &dest[PREAMBLE];
+	uint32_t crc = crcByte (0, srcLen);
+	raw[0] = srcLen ^ whitening[0];
+	for (size_t i = 0; i < srcLen; i++) {
+		crc = crcByte (crc, src[i]);
+		raw[1+i] = src[i] ^ whitening[1+i];
+	}
+	for (unsigned int i = 0; i < CRC_LEN; i++) {
+		raw[1+srcLen+i] = (crc >> (i*8)) ^ whitening[1+srcLen+i];
+	}
+	memset (&raw[rawLen], 0, TRAILING_ZEROS_BYTES);
+
+	return PREAMBLE*8+rawLen*8+TRAILING_ZEROS;
 }
+
+static packetDecodeStatus scrambledDecode (const uint8_t * const src,
+		const size_t srcBits, uint8_t * const dest, const size_t destLen,
+		size_t * const payloadLen) {
+	/* first byte is the payload length */
+	const size_t len = srcBits >= 8 ? src[0] ^ whitening[0] : 0;
+	const size_t rawLen = 1+len+CRC_LEN;
+	if (len == 0 || rawLen*8 > srcBits || rawLen > destLen) {
+		SEGGER_RTT_printf (0, "packet len fail, %u\n", srcBits);
+		return PACKET_DECODE_LINECODE_FAIL;
+	}
+
+	for (size_t i = 0; i < rawLen; i++) {
+		dest[i] = src[i] ^ whitening[i];
+	}
+	const packetDecodeStatus ret = checkCrc (dest, rawLen);
+	if (ret != PACKET_DECODE_OK) {
+		return ret;
+	}
+
+	/* strip length byte, which may have been corrected */
+	if (dest[0] != len) {
+		SEGGER_RTT_printf (0, "length miscorrected\n");
+		return PACKET_DECODE_ECC_FAIL;
+	}
+	*payloadLen = dest[0];
+	memmove (dest, &dest[1], *payloadLen);
+
+	return PACKET_DECODE_OK;
+}
+
+static bool scrambledPeek (const uint8_t * const src, const size_t srcBits,
+		uint8_t * const dest, const size_t len) {
+	if ((1+len)*8 > srcBits) {
+		return false;
+	}
+	for (size_t i = 0; i < len; i++) {
+		dest[i] = src[1+i] ^ whitening[1+i];
+	}
+	return true;
+}
+
+static size_t scrambledTxLen (const size_t payloadLen) {
+	return PREAMBLE+1+payloadLen+CRC_LEN+TRAILING_ZEROS_BYTES;
+}
+
+static size_t scrambledRxLen (const size_t payloadLen) {
+	return (1+payloadLen+CRC_LEN)*8;
+}
+
+/*	NRZ without line code overhead, whitening keeps the data DC free and
+ *	transitions frequent on average
+ */
+void packetScrambledInit (packetEncoder * const enc) {
+	whiteningInit ();
+	enc->encode = scrambledEncode;
+	enc->decode = scrambledDecode;
+	enc->txlen = scrambledTxLen;
+	enc->rxlen = scrambledRxLen;
+	enc->peek = scrambledPeek;
+	enc->streamBegin = NULL;
+	enc->streamPush = NULL;
+	enc->streamEnd = NULL;
+}
+
+/* ===== reed-solomon ===== */
+
+/* codewords are interleaved bytewise, so a burst of up to
+ * RS_DEPTH*RS_PARITY/2 bytes is correctable */
+#define RS_DEPTH (4)
+/* the length byte is sent as two hamming coded nibbles first */
+#define RS_HEADER (2)
+
+/* extended hamming (8,4), distance 4 */
+static const uint8_t hamming84[16] = {
+	0x15, 0x02, 0x49, 0x5e, 0x64, 0x73, 0x38, 0x2f,
+	0xd0, 0xc7, 0x8c, 0x9b, 0xa1, 0xb6, 0xfd, 0xea,
+	};
+
+/*	Returns nibble or -1 if more than one bit is incorrect
+ */
+static int hammingDecode (const uint8_t v) {
+	for (unsigned int i = 0; i < sizeof (hamming84); i++) {
+		if (__builtin_popcount (v ^ hamming84[i]) <= 1) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/*	Unencoded message length for payloadLen: length byte, payload and crc,
+ *	padded to RS_DEPTH
+ */
+static size_t packetRsRawLen (const size_t payloadLen) {
+	return (1+payloadLen+CRC_LEN+RS_DEPTH-1)/RS_DEPTH*RS_DEPTH;
+}
+
+/*	Message and parity of all codewords
+ */
+static size_t packetRsCodedLen (const size_t payloadLen) {
+	return packetRsRawLen (payloadLen)+RS_DEPTH*RS_PARITY;
+}
+
+static size_t packetRsEncode (const uint8_t * const src, const size_t srcLen,
+		uint8_t * const dest, const size_t destLen) {
+	assert (src != NULL);
+	assert (srcLen > 0 && srcLen <= UINT8_MAX);
+	assert (dest != NULL);
+
+	const size_t rawLen = packetRsRawLen (srcLen);
+	const size_t codedLen = packetRsCodedLen (srcLen);
+	assert (PREAMBLE+RS_HEADER+codedLen+TRAILING_ZEROS_BYTES <= destLen);
+
+	dest[0] = 0xaa;
+	dest[1] = 0x9a;
+	dest[2] = 0x69;
+	dest[PREAMBLE] = hamming84[srcLen >> 4];
+	dest[PREAMBLE+1] = hamming84[srcLen & 0xf];
+
+	uint8_t * const raw = &dest[PREAMBLE+RS_HEADER];
+	const size_t bodySize = rawLen - CRC_LEN;
+	raw[0] = srcLen;
+	memcpy (&raw[1], src, srcLen);
+	memset (&raw[1+srcLen], 0, bodySize-1-srcLen);
+	crcPut (&raw[bodySize], crcCalc (raw, bodySize));
+
+	/* parity follows the message, interleaved as well */
+	for (unsigned int i = 0; i < RS_DEPTH; i++) {
+		rsEncode (&raw[i], codedLen/RS_DEPTH, RS_DEPTH);
+	}
+
+	memset (&raw[codedLen], 0, TRAILING_ZEROS_BYTES);
+
+	return PREAMBLE*8+(RS_HEADER+codedLen)*8+TRAILING_ZEROS;
+}
+
+static packetDecodeStatus packetRsDecode (const uint8_t * const src,
+		const size_t srcBits, uint8_t * const dest, const size_t destLen,
+		size_t * const payloadLen) {
+	if (srcBits < RS_HEADER*8) {
+		SEGGER_RTT_printf (0, "packet len fail, %u\n", srcBits);
+		return PACKET_DECODE_LINECODE_FAIL;
+	}
+	const int hi = hammingDecode (src[0]), lo = hammingDecode (src[1]);
+	if (hi == -1 || lo == -1) {
+		SEGGER_RTT_printf (0, "hamming fail\n");
+		return PACKET_DECODE_LINECODE_FAIL;
+	}
+
+	const size_t len = (hi << 4) | lo;
+	const size_t rawLen = packetRsRawLen (len);
+	const size_t codedLen = packetRsCodedLen (len);
+	if (len == 0 || (RS_HEADER+codedLen)*8 > srcBits || codedLen > destLen) {
+		SEGGER_RTT_printf (0, "packet len fail, %u, %u\n", srcBits, len);
+		return PACKET_DECODE_LINECODE_FAIL;
+	}
+
+	memcpy (dest, &src[RS_HEADER], codedLen);
+	for (unsigned int i = 0; i < RS_DEPTH; i++) {
+		if (rsDecode (&dest[i], codedLen/RS_DEPTH, RS_DEPTH) == -1) {
+			SEGGER_RTT_printf (0, "uncorrectable rs codeword %u\n", i);
+			return PACKET_DECODE_ECC_FAIL;
+		}
+	}
+
+	/* catches miscorrections */
+	const packetDecodeStatus ret = checkCrc (dest, rawLen);
+	if (ret != PACKET_DECODE_OK) {
+		return ret;
+	}
+
+	/* strip length byte, which may have been corrected */
+	if (dest[0] == 0 || packetRsRawLen (dest[0]) != rawLen) {
+		SEGGER_RTT_printf (0, "length miscorrected\n");
+		return PACKET_DECODE_ECC_FAIL;
+	}
+	*payloadLen = dest[0];
+	memmove (dest, &dest[1], *payloadLen);
+
+	return PACKET_DECODE_OK;
+}
+
+/*	The code is systematic, the message is sent as is before the parity
+ */
+static bool packetRsPeek (const uint8_t * const src, const size_t srcBits,
+		uint8_t * const dest, const size_t len) {
+	if ((RS_HEADER+1+len)*8 > srcBits) {
+		return false;
+	}
+	memcpy (dest, &src[RS_HEADER+1], len);
+	return true;
+}
+
+static size_t packetRsTxLen (const size_t payloadLen) {
+	return PREAMBLE+RS_HEADER+packetRsCodedLen (payloadLen)+TRAILING_ZEROS_BYTES;
+}
+
+static size_t packetRsRxLen (const size_t payloadLen) {
+	return (RS_HEADER+packetRsCodedLen (payloadLen))*8;
+}
+
+/*	No line code, the receiver relies on the header for the length
+ */
+void packetRsInit (packetEncoder * const enc) {
+	rsInit ();
+	enc->encode = packetRsEncode;
+	enc->decode = packetRsDecode;
+	enc->txlen = packetRsTxLen;
+	enc->rxlen = packetRsRxLen;
+	enc->peek = packetRsPeek;
+	enc->streamBegin = NULL;
+	enc->streamPush = NULL;
+	enc->streamEnd = NULL;
+}
+
+/*	Init enc as encoder type (PACKET_8B10B, …), false if there is no such
+ *	encoder
+ */
+bool packetInit (packetEncoder * const enc, const uint8_t type) {
+	assert (enc != NULL);
+
+	switch (type) {
+		case PACKET_8B10B:
+			packet8b10bInit (enc);
+			return true;
+
+		case PACKET_RS:
+			packetRsInit (enc);
+			return true;
+
+		case PACKET_SCRAMBLED:
+			packetScrambledInit (enc);
+			return true;
+
+		case PACKET_IDENTITY:
+			packetIdentityInit (enc);
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+/* ===== majority voting ===== */
+
+/*	Bitwise majority of count (3 to 7) copies of words 32 bit words each. Ties
+ *	resolve to zero. A bit-sliced counter handles 32 bits at once, which is as
+ *	good as the Cortex-M4 SIMD instructions get for single bit lanes.
+ */
+void packetVote (uint32_t * const dest, const uint32_t * const * const copies,
+		const unsigned int count, const size_t words) {
+	assert (count >= 3 && count <= 7);
+
+	if (count == 3) {
+		const uint32_t * const a = copies[0], * const b = copies[1],
+				* const c = copies[2];
+		for (size_t i = 0; i < words; i++) {
+			dest[i] = (a[i] & b[i]) | (c[i] & (a[i] | b[i]));
+		}
+		return;
+	}
+
+	const unsigned int threshold = count/2+1;
+	for (size_t i = 0; i < words; i++) {
+		/* three bit counter per bit position */
+		uint32_t c0 = 0, c1 = 0, c2 = 0;
+		for (unsigned int j = 0; j < count; j++) {
+			const uint32_t v = copies[j][i];
+			const uint32_t carry0 = c0 & v;
+			c0 ^= v;
+			const uint32_t carry1 = c1 & carry0;
+			c1 ^= carry0;
+			c2 |= carry1;
+		}
+		switch (threshold) {
+			case 3:
+				dest[i] = c2 | (c1 & c0);
+				break;
+
+			case 4:
+				dest[i] = c2;
+				break;
+
+			default:
+				assert (0);
+				break;
+		}
+	}
+}
+
+#ifdef _TEST
+/* tests */
+#include <check.h>
+
+/* decoder messages are not interesting here */
+int SEGGER_RTT_printf (unsigned int buffer, const char * fmt, ...) {
+	return 0;
+}
+
+/*	Encode body and decode it again, as a whole and streaming if supported.
+ *	flip is a bit in the received message to corrupt, or -1
+ */
+static void roundTrip (const packetEncoder * const enc, const uint8_t type,
+		const uint8_t * const body, const size_t len, const int flip) {
+	uint8_t tx[FMAC_MAX_PACKET_LEN];
+	const size_t txBits = enc->encode (body, len, tx, sizeof (tx));
+	fail_unless (txBits/8 <= enc->txlen (len));
+	uint8_t * const rx = &tx[PREAMBLE];
+	const size_t rxBits = enc->rxlen (len);
+	fail_unless (rxBits <= txBits-PREAMBLE*8);
+	uint8_t dec[FMAC_MAX_PACKET_LEN];
+	size_t decLen;
+	const size_t peekLen = len < 3 ? len : 3;
+	fail_unless (enc->peek (rx, rxBits, dec, peekLen) &&
+			memcmp (dec, body, peekLen) == 0,
+			"encoder %u, len %zu: wrong peek", type, len);
+
+	if (flip >= 0) {
+		rx[flip/8] ^= 1 << (flip%8);
+	}
+
+	const packetDecodeStatus ret = enc->decode (rx, rxBits, dec,
+			sizeof (dec), &decLen);
+	fail_unless (ret == PACKET_DECODE_OK, "encoder %u, len %zu, flip %d: %u",
+			type, len, flip, ret);
+	fail_unless (decLen == len && memcmp (dec, body, len) == 0,
+			"encoder %u, len %zu, flip %d: wrong payload", type, len, flip);
+
+	if (enc->streamBegin != NULL) {
+		packetStream s;
+		memset (dec, 0, sizeof (dec));
+		enc->streamBegin (&s, dec, sizeof (dec));
+		for (size_t pos = 0; pos < rxBits; pos += 32) {
+			const size_t n = rxBits-pos < 32 ? rxBits-pos : 32;
+			uint32_t block = 0;
+			memcpy (&block, &rx[pos/8], (n+7)/8);
+			enc->streamPush (&s, block, n);
+		}
+		fail_unless (enc->streamEnd (&s, &decLen) == PACKET_DECODE_OK,
+				"encoder %u, len %zu: stream failed", type, len);
+		fail_unless (decLen == len && memcmp (dec, body, len) == 0,
+				"encoder %u, len %zu: wrong stream payload", type, len);
+	}
+}
+
+START_TEST (testRoundTrip) {
+	packetCrcInit ();
+	srand (1);
+
+	uint8_t type = 0;
+	packetEncoder enc;
+	while (packetInit (&enc, type)) {
+		for (size_t len = 1; len <= FMAC_MAX_BODY_LEN; len++) {
+			uint8_t body[FMAC_MAX_BODY_LEN];
+			for (size_t i = 0; i < len; i++) {
+				body[i] = rand ();
+			}
+			roundTrip (&enc, type, body, len, -1);
+			/* line code errors are not correctable in 8b10b, a wrong length
+			 * byte is not correctable without line code */
+#if PACKET_CRC_BITS == 8 && !defined(CRC8_CORRECT)
+			const bool correctable = false;
+#elif PACKET_CRC_BITS == 8
+			const bool correctable = len+5 <= CRC8_MAX_MSGLEN;
+#else
+			const bool correctable = true;
+#endif
+			if (type != PACKET_8B10B && correctable) {
+				roundTrip (&enc, type, body, len, 8+rand () % (len*8));
+			}
+		}
+		type++;
+	}
+	fail_unless (type == PACKET_ENCODER_COUNT);
+} END_TEST
+
+Suite *test() {
+	Suite *s = suite_create ("packet");
+
+	TCase *tc_core = tcase_create ("encoders");
+	tcase_add_test (tc_core, testRoundTrip);
+	suite_add_tcase (s, tc_core);
+
+	return s;
+}
+
+/*	test suite runner
+ */
+int main (int argc, char **argv) {
+	int numberFailed;
+	SRunner *sr = srunner_create (test ());
+
+	srunner_run_all (sr, CK_ENV);
+	numberFailed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+
+	return (numberFailed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
+
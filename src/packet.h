@@ -23,6 +23,7 @@ THE SOFTWARE.
 #pragma once
 
 #include <stdint.h>
+#include <stdbool.h>
 #include <stdlib.h>
 
 typedef enum {
@@ -33,21 +34,69 @@ typedef enum {
 	PACKET_DECODE_ECC_FAIL,
 } packetDecodeStatus;
 
+/* src is srcLen bits long, decoded payload length is returned in payloadLen */
 typedef packetDecodeStatus (*packetEncoderDec) (const uint8_t * const src,
-		const size_t srcLen, uint8_t * const dest, const size_t destLen);
+		const size_t srcLen, uint8_t * const dest, const size_t destLen,
+		size_t * const payloadLen);
 typedef size_t (*packetEncoderEnc) (const uint8_t * const src,
 		const size_t srcLen, uint8_t * const dest, const size_t destLen);
 typedef size_t (*packetEncoderLen) (const size_t payloadLen);
+/* first len payload bytes of src (srcLen bits) without any checks, false if
+ * they are not available or not valid line code */
+typedef bool (*packetEncoderPeek) (const uint8_t * const src,
+		const size_t srcLen, uint8_t * const dest, const size_t len);
+
+/* state of a streaming decoder */
+typedef struct {
+	uint8_t *dest;
+	size_t destLen;
+	/* received bits not decoded yet */
+	uint64_t bits;
+	unsigned int pending;
+	/* bytes decoded, message length once known (0 before), payload length */
+	size_t pos, rawLen, len;
+	uint32_t crc;
+	packetDecodeStatus status;
+} packetStream;
+
+/* decode while receiving, blocks of up to 32 bits as they come in from the
+ * tda, the payload is returned by streamEnd like decode does */
+typedef void (*packetEncoderStreamBegin) (packetStream * const s,
+		uint8_t * const dest, const size_t destLen);
+typedef void (*packetEncoderStreamPush) (packetStream * const s,
+		const uint32_t block, const uint8_t bits);
+typedef packetDecodeStatus (*packetEncoderStreamEnd) (packetStream * const s,
+		size_t * const payloadLen);
 
 typedef struct {
 	packetEncoderEnc encode;
 	packetEncoderDec decode;
-	/* tx len for payload in _bytes_ */
+	/* tx len for payload in _bytes_, payload may be shorter */
 	packetEncoderLen txlen;
-	/* rx len for payload in _bits_ */
+	/* rx len for payload in _bits_, payload may be shorter */
 	packetEncoderLen rxlen;
+	packetEncoderPeek peek;
+	/* optional, NULL if the encoder can only decode whole framelets */
+	packetEncoderStreamBegin streamBegin;
+	packetEncoderStreamPush streamPush;
+	packetEncoderStreamEnd streamEnd;
 } packetEncoder;
 
+/* packet encoders, selected by packetInit. The default is PACKET_ENCODER in
+ * config.h, the host may choose another one through the CONFIG register */
+#define PACKET_8B10B (0)
+#define PACKET_RS (1)
+#define PACKET_SCRAMBLED (2)
+#define PACKET_IDENTITY (3)
+/* not an actual encoder */
+#define PACKET_ENCODER_COUNT (4)
+
+bool packetInit (packetEncoder * const enc, const uint8_t type);
+void packetCrcInit (void);
 void packet8b10bInit (packetEncoder * const enc);
 void packetIdentityInit (packetEncoder * const enc);
+void packetRsInit (packetEncoder * const enc);
+void packetScrambledInit (packetEncoder * const enc);
+void packetVote (uint32_t * const dest, const uint32_t * const * const copies,
+		const unsigned int count, const size_t words);
 
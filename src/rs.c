@@ -0,0 +1,224 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*	Reed-Solomon code over GF(2^8), polynomial 0x11d, generator roots α^0 to
+ *	α^(RS_PARITY-1). Codewords are shortened to n bytes (including parity) and
+ *	stored every stride bytes, so interleaved codewords can be coded in place.
+ */
+
+#include <assert.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "rs.h"
+
+static uint8_t gfExp[512], gfLog[256];
+static uint8_t rsGenerator[RS_PARITY+1];
+
+static uint8_t gfMul (const uint8_t a, const uint8_t b) {
+	if (a == 0 || b == 0) {
+		return 0;
+	}
+	return gfExp[gfLog[a] + gfLog[b]];
+}
+
+static uint8_t gfDiv (const uint8_t a, const uint8_t b) {
+	assert (b != 0);
+	if (a == 0) {
+		return 0;
+	}
+	return gfExp[gfLog[a] + 255 - gfLog[b]];
+}
+
+/*	α^e for any e >= 0
+ */
+static uint8_t gfPow (const unsigned int e) {
+	return gfExp[e%255];
+}
+
+/*	Evaluate polynomial p of degree deg (coefficients by degree) at x
+ */
+static uint8_t polyEval (const uint8_t * const p, const unsigned int deg,
+		const uint8_t x) {
+	uint8_t y = p[deg];
+	for (unsigned int i = deg; i > 0; i--) {
+		y = gfMul (y, x) ^ p[i-1];
+	}
+	return y;
+}
+
+/*	Build log/antilog tables and the generator polynomial, must be called
+ *	before using the codec
+ */
+void rsInit (void) {
+	unsigned int x = 1;
+	for (unsigned int i = 0; i < 255; i++) {
+		gfExp[i] = x;
+		gfLog[x] = i;
+		x <<= 1;
+		if (x & 0x100) {
+			x ^= 0x11d;
+		}
+	}
+	/* avoid the modulo in gfMul/gfDiv */
+	for (unsigned int i = 255; i < sizeof (gfExp); i++) {
+		gfExp[i] = gfExp[i-255];
+	}
+
+	/* g(x) = (x-α^0)(x-α^1)… */
+	memset (rsGenerator, 0, sizeof (rsGenerator));
+	rsGenerator[0] = 1;
+	for (unsigned int i = 0; i < RS_PARITY; i++) {
+		const uint8_t root = gfPow (i);
+		for (unsigned int j = i+1; j > 0; j--) {
+			rsGenerator[j] = rsGenerator[j-1] ^ gfMul (rsGenerator[j], root);
+		}
+		rsGenerator[0] = gfMul (rsGenerator[0], root);
+	}
+}
+
+/*	Compute parity of the first n-RS_PARITY bytes and store it in the last
+ *	RS_PARITY bytes of the codeword
+ */
+void rsEncode (uint8_t * const buf, const size_t n, const size_t stride) {
+	assert (n > RS_PARITY && n <= 255);
+	/* remainder, highest degree first */
+	uint8_t parity[RS_PARITY];
+	memset (parity, 0, sizeof (parity));
+	for (size_t i = 0; i < n-RS_PARITY; i++) {
+		const uint8_t feedback = buf[i*stride] ^ parity[0];
+		for (unsigned int j = 0; j < RS_PARITY-1; j++) {
+			parity[j] = parity[j+1] ^ gfMul (feedback, rsGenerator[RS_PARITY-1-j]);
+		}
+		parity[RS_PARITY-1] = gfMul (feedback, rsGenerator[0]);
+	}
+	for (unsigned int j = 0; j < RS_PARITY; j++) {
+		buf[(n-RS_PARITY+j)*stride] = parity[j];
+	}
+}
+
+/*	Correct codeword in place. Returns the number of bytes corrected or -1 if
+ *	the codeword is uncorrectable. Berlekamp-Massey finds the error locator,
+ *	Chien search its roots within the shortened codeword and Forney the error
+ *	values.
+ */
+int rsDecode (uint8_t * const buf, const size_t n, const size_t stride) {
+	assert (n > RS_PARITY && n <= 255);
+
+	/* byte i is the coefficient of x^(n-1-i) */
+	uint8_t syndrome[RS_PARITY];
+	bool ok = true;
+	for (unsigned int j = 0; j < RS_PARITY; j++) {
+		const uint8_t root = gfPow (j);
+		uint8_t s = 0;
+		for (size_t i = 0; i < n; i++) {
+			s = gfMul (s, root) ^ buf[i*stride];
+		}
+		syndrome[j] = s;
+		ok = ok && s == 0;
+	}
+	if (ok) {
+		return 0;
+	}
+
+	/* Berlekamp-Massey */
+	uint8_t locator[RS_PARITY+1], prev[RS_PARITY+1];
+	memset (locator, 0, sizeof (locator));
+	memset (prev, 0, sizeof (prev));
+	locator[0] = 1;
+	prev[0] = 1;
+	unsigned int errors = 0, shift = 1;
+	uint8_t prevDiscrepancy = 1;
+	for (unsigned int k = 0; k < RS_PARITY; k++) {
+		uint8_t d = syndrome[k];
+		for (unsigned int i = 1; i <= errors; i++) {
+			d ^= gfMul (locator[i], syndrome[k-i]);
+		}
+		if (d == 0) {
+			++shift;
+			continue;
+		}
+		const uint8_t scale = gfDiv (d, prevDiscrepancy);
+		uint8_t tmp[RS_PARITY+1];
+		memcpy (tmp, locator, sizeof (tmp));
+		for (unsigned int i = shift; i <= RS_PARITY; i++) {
+			locator[i] ^= gfMul (scale, prev[i-shift]);
+		}
+		if (2*errors <= k) {
+			errors = k+1-errors;
+			memcpy (prev, tmp, sizeof (prev));
+			prevDiscrepancy = d;
+			shift = 1;
+		} else {
+			++shift;
+		}
+	}
+	if (errors > RS_PARITY/2) {
+		return -1;
+	}
+
+	/* error evaluator Ω(x) = S(x)Λ(x) mod x^RS_PARITY */
+	uint8_t evaluator[RS_PARITY];
+	for (unsigned int i = 0; i < RS_PARITY; i++) {
+		uint8_t v = 0;
+		for (unsigned int j = 0; j <= i && j <= errors; j++) {
+			v ^= gfMul (locator[j], syndrome[i-j]);
+		}
+		evaluator[i] = v;
+	}
+
+	/* Chien search, error at byte i if Λ(α^-(n-1-i)) = 0 */
+	size_t position[RS_PARITY/2];
+	uint8_t value[RS_PARITY/2];
+	unsigned int found = 0;
+	for (size_t i = 0; i < n; i++) {
+		const unsigned int e = n-1-i;
+		const uint8_t xInv = gfPow (255-e);
+		if (polyEval (locator, errors, xInv) != 0) {
+			continue;
+		}
+		if (found >= errors) {
+			return -1;
+		}
+		/* Forney: e = X Ω(X^-1)/Λ'(X^-1), Λ' has the odd terms only */
+		uint8_t derivative = 0;
+		for (unsigned int j = 1; j <= errors; j += 2) {
+			derivative ^= gfMul (locator[j], gfPow ((255-e)*(j-1)));
+		}
+		if (derivative == 0) {
+			return -1;
+		}
+		position[found] = i;
+		value[found] = gfMul (gfPow (e),
+				gfDiv (polyEval (evaluator, RS_PARITY-1, xInv), derivative));
+		++found;
+	}
+	/* roots outside of the shortened codeword */
+	if (found != errors) {
+		return -1;
+	}
+
+	for (unsigned int j = 0; j < found; j++) {
+		buf[position[j]*stride] ^= value[j];
+	}
+	return found;
+}
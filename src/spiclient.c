@@ -30,6 +30,7 @@ THE SOFTWARE.
 #include <stdio.h>
 #include "util.h"
 #include "config.h"
+#include "timer.h"
 
 #if (defined(USE_SPI) && defined(USE_UART)) || !(defined(USE_SPI) || defined(USE_UART))
 #error "Please define either USE_UART or USE_SPI"
@@ -84,8 +85,11 @@ typedef enum {
 	CMD_WRITEBUF = 0x2,
 	CMD_READREG = 0x3,
 	CMD_WRITEREG = 0x4,
+	/* batched READBUF/WRITEBUF with pending counts in the response */
+	CMD_READBUFS = 0x5,
+	CMD_WRITEBUFS = 0x6,
 	/* not an actual command, but the #cmd’s above */
-	CMD_COUNT = 0x5,
+	CMD_COUNT = 0x7,
 } spiclientCommand;
 
 typedef enum {
@@ -98,10 +102,48 @@ typedef enum {
 	REG_RXOVERFLOW = 0x4,
 	/* configuration register */
 	REG_CONFIG = 0x5,
+	/* packets recovered by burst/two bit crc correction since the last read */
+	REG_CORRECTED = 0x6,
+	/* multicast group membership */
+	REG_GROUPS = 0x7,
+	/* interrupt coalescing, packets and timeout in μs */
+	REG_IRQPACKETS = 0x8,
+	REG_IRQTIMEOUT = 0x9,
+	/* guard time δ in μs, writable */
+	REG_DELTA = 0xa,
+	/* guard time calibration, see fmacGetTiming */
+	REG_CALDELTA = 0xb,
+	REG_SWITCHING = 0xc,
+	REG_AIRTIME = 0xd,
+	REG_EOMTIME = 0xe,
+	/* clock skew, see fmacGetSkew */
+	REG_DRIFT = 0xf,
+	REG_DRIFTING = 0x10,
 	/* not an actual register */
-	REG_COUNT = 0x6,
+	REG_COUNT = 0x11,
+	/* skew of station i at REG_SKEW+i, up to KSET_MAX_N */
+	REG_SKEW = 0x20,
 } spiclientRegister;
 
+/* the upper byte of CONFIG holds train length and packet encoder */
+#define CONFIG_TRAIN_MASK (0x1f)
+#define CONFIG_ENCODER_SHIFT (5)
+
+/* usic rx/tx fifo depth in words, see spiclientInit */
+#define USIC_FIFO_SIZE (32)
+/* refill the tx fifo once it drained to this level, the interrupt must be
+ * served before the master clocked out the remaining words */
+#define USIC_TXFIFO_LIMIT (16)
+/* rx pending, tx pending and packet count */
+#define BATCH_HEADER_LEN (3)
+/* longest WRITEBUFS request after the command byte. Requests are not
+ * streamed, so the command byte and this must leave one word of the rx fifo
+ * free to tell them from overflows */
+#define WRITEBATCH_MAX (USIC_FIFO_SIZE-2)
+
+/* longest coalescing timeout, keeps the timer deadline well within range */
+#define COALESCE_MAX_US (1000000U)
+
 static spiclient *staticClient;
 static uint8_t upBuffer[128];
 
@@ -111,6 +153,7 @@ static void initFifos (spiclient * const client) {
 }
 
 #include "fmac.h"
+#include "crc32.h"
 
 /*	dump data to RTT channel 1, used to display it on the host
  */
@@ -120,12 +163,62 @@ static void dumpData (const char * const payload, const size_t size) {
 	SEGGER_RTT_Write (1, payload, size);
 }
 
+/*	Assert the host interrupt line (low-active), it is held until the host
+ *	drained the rx fifo
+ */
+static void irqAssert (spiclient * const client) {
+	timerStop (&client->timeout);
+	if (!client->irqAsserted) {
+		client->irqAsserted = true;
+		XMC_GPIO_SetOutputLow (INTERRUPT);
+	}
+}
+
+/*	Release the line once the rx fifo is empty
+ */
+static void irqRelease (spiclient * const client) {
+	if (fifoItems (&client->rxFifo) == 0) {
+		timerStop (&client->timeout);
+		client->irqAsserted = false;
+		XMC_GPIO_SetOutputHigh (INTERRUPT);
+	}
+}
+
+/*	A packet was queued: assert the line if enough are pending, otherwise
+ *	start the timeout with the first one
+ */
+static void coalesce (spiclient * const client) {
+	if (client->irqAsserted) {
+		return;
+	}
+	const size_t pending = fifoItems (&client->rxFifo);
+	if (pending >= client->irqPackets) {
+		irqAssert (client);
+	} else if (pending == 1 && client->irqTimeout > 0) {
+		timerStart (&client->timeout, TIMER_US_TO_TICKS (client->irqTimeout));
+	}
+}
+
+/*	Coalescing timeout expired, runs in the timer interrupt. It preempts the
+ *	spi interrupt, but packets are only queued from the main loop, so
+ *	irqRelease and this agree on whether the fifo is empty.
+ */
+static void timeout (timer * const t, void * const data) {
+	spiclient * const client = data;
+	if (fifoItems (&client->rxFifo) > 0) {
+		irqAssert (client);
+	}
+}
+
 /*	Called whenever station wants to send data (i.e. this node own the current slot)
+ *	Runs in the main loop, see fmacProcess.
  */
-bool spiclientTx (void * const data, const void ** const payload, size_t * const size) {
+bool spiclientTx (void * const data, const void ** const payload,
+		size_t * const size, uint8_t * const dest) {
 	assert (data != NULL);
 	assert (payload != NULL);
 	assert (size != NULL);
+	assert (dest != NULL);
 	spiclient * const client = (spiclient * const) data;
 
 #ifdef DEBUG_CONTINUOUS_SEND
@@ -140,12 +233,19 @@ bool spiclientTx (void * const data, const void ** const payload, size_t * const
 	++seqnum;
 	*payload = foo;
 	*size = sizeof (foo);
+	*dest = FMAC_ADDR_BROADCAST;
 	return true;
 #else
-	void * const ret = fifoPop (&client->txFifo);
-	if (ret != NULL) {
-		*payload = ret;
-		*size = client->payloadSize;
+	/* copied out before popping, the spi interrupt may reuse the slot
+	 * right after */
+	const uint8_t * const item = fifoPeek (&client->txFifo);
+	if (item != NULL) {
+		uint8_t * const ret = client->txItem;
+		memcpy (ret, item, 2+item[0]);
+		fifoPop (&client->txFifo);
+		*dest = ret[1];
+		*payload = &ret[2];
+		*size = ret[0];
 		#ifdef DEBUG_DUMP_TXDATA
 		dumpData (*payload, *size);
 		#endif
@@ -170,13 +270,15 @@ bool spiclientRx (void * const data, const void * const payload, const size_t si
 	uint8_t * const ret = fifoPushAlloc (&client->rxFifo);
 
 	if (ret != NULL) {
-		/* high-low edge signals incoming packet */
-		XMC_GPIO_SetOutputLow (INTERRUPT);
-		assert (size <= client->rxFifo.entrySize);
-		memcpy (ret, payload, size);
+		assert (size <= client->payloadSize);
+		ret[0] = size;
+		memcpy (&ret[1], payload, size);
 
 		fifoPushCommit (&client->rxFifo);
-		XMC_GPIO_SetOutputHigh (INTERRUPT);
+		/* the host interface may drain the fifo in between */
+		__disable_irq ();
+		coalesce (client);
+		__enable_irq ();
 		return true;
 	} else {
 		++client->overflowCount;
@@ -184,27 +286,128 @@ bool spiclientRx (void * const data, const void * const payload, const size_t si
 	}
 }
 
-static void queueResponse (XMC_USIC_CH_t * const dev, const void * const data, const size_t size) {
-	const uint8_t * const byte = data;
-	/* atomic fifo write */
-	XMC_SPI_CH_DisableDataTransmission (dev); /* same for UART */
+/*	Apply a CONFIG write. The fifos and the mac are reset, which must not
+ *	happen while the main loop is using them, so the interrupt only records
+ *	it. Call from the main loop.
+ */
+void spiclientProcess (spiclient * const client) {
+	assert (client != NULL);
+
+	if (!client->configPending) {
+		return;
+	}
+
+	/* the fifos are shared with the host interface and rxcb, which may run
+	 * from the tda interrupt */
+	__disable_irq ();
+	client->configPending = false;
+	const uint32_t config = client->configNext;
+	client->config = config;
+	const uint8_t stationId = config & 0xff;
+	const uint8_t numStations = (config >> 8) & 0xff;
+	const uint8_t payloadSize = (config >> 16) & 0xff;
+	const uint8_t train = (config >> 24) & CONFIG_TRAIN_MASK;
+	const uint8_t encoder = config >> (24+CONFIG_ENCODER_SHIFT);
+	client->payloadSize = payloadSize;
+	initFifos (client);
+	irqRelease (client);
+	__enable_irq ();
+
+	debug ("configuring with i=%u, n=%u, len=%u, train=%u, "
+			"encoder=%u\n", stationId, numStations, payloadSize,
+			train, encoder);
+	assert (client->initMac != NULL);
+	client->initMac (client->macData, stationId, numStations, payloadSize,
+			train, encoder);
+}
+
+/*	Drop the response still being sent, if any
+ */
+static void responseReset (spiclient * const client) {
+	XMC_USIC_CH_TXFIFO_DisableEvent (client->dev,
+			XMC_USIC_CH_TXFIFO_EVENT_CONF_STANDARD);
+	XMC_USIC_CH_TXFIFO_Flush (client->dev);
+	client->responseLen = 0;
+	client->responsePos = 0;
+	client->responseBreak = false;
+}
+
+/*	Move response bytes into the usic tx fifo until it is full. Called again
+ *	by the fifo’s standard event once it drained to USIC_TXFIFO_LIMIT.
+ */
+static void refill (spiclient * const client) {
+	XMC_USIC_CH_t * const dev = client->dev;
+	while (client->responsePos < client->responseLen &&
+			!XMC_USIC_CH_TXFIFO_IsFull (dev)) {
+		XMC_USIC_CH_TXFIFO_PutData (dev,
+				client->response[client->responsePos++]);
+	}
+#if defined(USE_UART)
+	if (client->responsePos == client->responseLen && client->responseBreak &&
+			!XMC_USIC_CH_TXFIFO_IsFull (dev)) {
+		XMC_USIC_CH_TXFIFO_PutDataFLEMode (dev, 0, 13); /* generate a break symbol */
+		client->responseBreak = false;
+	}
+#endif
+	if (client->responsePos == client->responseLen && !client->responseBreak) {
+		XMC_USIC_CH_TXFIFO_DisableEvent (dev,
+				XMC_USIC_CH_TXFIFO_EVENT_CONF_STANDARD);
+	}
+}
+
+static void responseBegin (spiclient * const client) {
+	responseReset (client);
 #if defined(USE_SPI)
 	/* start of frame/response marker */
-	XMC_USIC_CH_TXFIFO_PutData (dev, 0xaa);
+	client->response[client->responseLen++] = 0xaa;
 #endif
-	for (size_t i = 0; i < size; i++) {
-		assert (!XMC_USIC_CH_TXFIFO_IsFull (dev));
-		debug ("wrote %x (%u)\n", byte[i], i);
-		XMC_USIC_CH_TXFIFO_PutData (dev, byte[i]);
-	}
+}
+
+static void responseAppend (spiclient * const client, const void * const data,
+		const size_t size) {
+	/* leave room for the end marker */
+	assert (client->responseLen+size < sizeof (client->response));
+	memcpy (&client->response[client->responseLen], data, size);
+	client->responseLen += size;
+}
+
+/*	Start sending the response. Only the first fifo fill is atomic, the master
+ *	must not clock faster than the refill interrupt can keep up with.
+ */
+static void responseEnd (spiclient * const client) {
+	XMC_USIC_CH_t * const dev = client->dev;
 #if defined(USE_SPI)
-	XMC_USIC_CH_TXFIFO_PutData (dev, 0xff);
+	client->response[client->responseLen++] = 0xff;
 #elif defined(USE_UART)
-	XMC_USIC_CH_TXFIFO_PutDataFLEMode (dev, 0, 13); /* generate a break symbol */
+	client->responseBreak = true;
 #endif
+	debug ("response of %u bytes\n", client->responseLen);
+	XMC_SPI_CH_DisableDataTransmission (dev); /* same for UART */
+	refill (client);
+	if (client->responsePos < client->responseLen || client->responseBreak) {
+		XMC_USIC_CH_TXFIFO_EnableEvent (dev,
+				XMC_USIC_CH_TXFIFO_EVENT_CONF_STANDARD);
+	}
 	XMC_SPI_CH_EnableDataTransmission (dev);
 }
 
+static void queueResponse (spiclient * const client, const void * const data,
+		const size_t size) {
+	responseBegin (client);
+	responseAppend (client, data, size);
+	responseEnd (client);
+}
+
+/*	Read 32 bit register value, LSB first
+ */
+static uint32_t readValue (XMC_USIC_CH_t * const dev) {
+	uint32_t val = 0;
+	for (unsigned int i = 0; i < sizeof (val); i++) {
+		val |= (uint32_t) XMC_USIC_CH_RXFIFO_GetData (dev) << (i*8);
+	}
+	return val;
+}
+
 /*	Move bytes from RXFIFO to buf
  */
 static unsigned int readFifoInto (XMC_USIC_CH_t * const dev,
@@ -218,6 +421,82 @@ static unsigned int readFifoInto (XMC_USIC_CH_t * const dev,
 	return filled;
 }
 
+/*	Fill header of batched responses with the pending packet counts
+ */
+static void batchHeader (const spiclient * const client, uint8_t * const buf,
+		const uint8_t count) {
+	buf[0] = fifoItems (&client->rxFifo);
+	buf[1] = fifoItems (&client->txFifo);
+	buf[2] = count;
+}
+
+/*	Pop all packets into one response, it is sized for a full fifo
+ */
+static void readBatch (spiclient * const client) {
+	responseBegin (client);
+	/* header is filled in once the packets are known */
+	uint8_t * const header = &client->response[client->responseLen];
+	client->responseLen += BATCH_HEADER_LEN;
+	uint8_t count = 0;
+	const uint8_t *item;
+	while ((item = fifoPeek (&client->rxFifo)) != NULL &&
+			client->responseLen+1+item[0] < sizeof (client->response)) {
+		responseAppend (client, item, 1+item[0]);
+		++count;
+		fifoPop (&client->rxFifo);
+	}
+	batchHeader (client, header, count);
+	responseEnd (client);
+	irqRelease (client);
+}
+
+/*	Push all packets of a batched write request, stop if the queue is full.
+ *	The request is read from the usic rx fifo only, so it must fit
+ *	WRITEBATCH_MAX bytes. Longer ones overflowed the fifo and are rejected as
+ *	a whole, like malformed ones.
+ */
+static void writeBatch (spiclient * const client) {
+	XMC_USIC_CH_t * const dev = client->dev;
+	/* one more to detect overflows */
+	uint8_t req[WRITEBATCH_MAX+1];
+	const unsigned int filled = readFifoInto (dev, req, sizeof (req));
+	/* validate all packets first, so none of a broken request is sent */
+	bool valid = filled > 0 && filled <= WRITEBATCH_MAX;
+	unsigned int pos = 1;
+	for (uint8_t j = 0; valid && j < req[0]; j++) {
+		/* length byte, destination and payload */
+		const uint8_t len = pos < filled ? req[pos] : 0;
+		if (len == 0 || len > client->payloadSize || pos+2+len > filled) {
+			debug ("invalid packet length %u\n", len);
+			valid = false;
+		}
+		pos += 2+len;
+	}
+	if (valid && pos != filled) {
+		debug ("trailing bytes in batch\n");
+		valid = false;
+	}
+	uint8_t count = 0;
+	pos = 1;
+	while (valid && count < req[0]) {
+		uint8_t * const ret = fifoPushAlloc (&client->txFifo);
+		if (ret == NULL) {
+			break;
+		}
+		const uint8_t len = req[pos];
+		memcpy (ret, &req[pos], 2+len);
+		fifoPushCommit (&client->txFifo);
+		pos += 2+len;
+		++count;
+	}
+	if (count > 0) {
+		client->triggerSend (client->macData);
+	}
+	uint8_t buf[BATCH_HEADER_LEN];
+	batchHeader (client, buf, count);
+	queueResponse (client, buf, sizeof (buf));
+}
+
 void ISR () {
 	spiclient * const client = staticClient;
 	XMC_USIC_CH_t * const dev = client->dev;
@@ -229,6 +508,11 @@ void ISR () {
 #endif
 	debug ("status: %x\n", status);
 
+	if (XMC_USIC_CH_TXFIFO_GetEvent (dev) & XMC_USIC_CH_TXFIFO_EVENT_STANDARD) {
+		XMC_USIC_CH_TXFIFO_ClearEvent (dev, XMC_USIC_CH_TXFIFO_EVENT_STANDARD);
+		refill (client);
+	}
+
 #if defined(USE_SPI)
 	if (status & XMC_SPI_CH_STATUS_FLAG_DATA_LOST_INDICATION) {
 		XMC_SPI_CH_ClearStatusFlag (dev, XMC_SPI_CH_STATUS_FLAG_DATA_LOST_INDICATION);
@@ -250,7 +534,7 @@ void ISR () {
 		const uint8_t command = XMC_USIC_CH_RXFIFO_GetData (dev);
 		if (command < CMD_COUNT) {
 			debug ("command %x\n", command);
-			XMC_USIC_CH_TXFIFO_Flush (dev);
+			responseReset (client);
 
 			switch (command) {
 				case CMD_INVALID:
@@ -258,24 +542,40 @@ void ISR () {
 
 				/* read receive fifo */
 				case CMD_READBUF: {
-					void * const ret = fifoPop (&client->rxFifo);
+					const uint8_t * const ret = fifoPop (&client->rxFifo);
 					if (ret != NULL) {
-						queueResponse (dev, ret, client->payloadSize);
+						/* length byte and payload */
+						queueResponse (client, ret, 1+ret[0]);
 					}
+					irqRelease (client);
 					break;
 				}
 
 				/* write transmit fifo */
 				case CMD_WRITEBUF: {
-					void * const ret = fifoPushAlloc (&client->txFifo);
+					uint8_t * const ret = fifoPushAlloc (&client->txFifo);
 					if (ret != NULL) {
-						readFifoInto (dev, ret, client->payloadSize);
-						fifoPushCommit (&client->txFifo);
-						client->triggerSend (client->macData);
+						/* length byte, destination and payload */
+						const unsigned int filled = readFifoInto (dev, ret,
+								2+client->payloadSize);
+						if (filled > 2 && ret[0] > 0 && ret[0] == filled-2) {
+							fifoPushCommit (&client->txFifo);
+							client->triggerSend (client->macData);
+						} else {
+							debug ("invalid packet length %u\n", ret[0]);
+						}
 					}
 					break;
 				}
 
+				case CMD_READBUFS:
+					readBatch (client);
+					break;
+
+				case CMD_WRITEBUFS:
+					writeBatch (client);
+					break;
+
 				/* read register */
 				case CMD_READREG: {
 					const uint8_t reg = XMC_USIC_CH_RXFIFO_GetData (dev);
@@ -283,34 +583,89 @@ void ISR () {
 					switch (reg) {
 						case REG_RXPENDING: {
 							const uint32_t items = fifoItems (&client->rxFifo);
-							queueResponse (dev, &items, sizeof (items));
+							queueResponse (client, &items, sizeof (items));
 							break;
 						}
 
 						case REG_TXPENDING: {
 							const uint32_t items = fifoItems (&client->txFifo);
-							queueResponse (dev, &items, sizeof (items));
+							queueResponse (client, &items, sizeof (items));
 							break;
 						}
 
 						case REG_RXOVERFLOW:
-							queueResponse (dev, &client->overflowCount,
+							queueResponse (client, &client->overflowCount,
 									sizeof (client->overflowCount));
 							client->overflowCount = 0;
 							break;
 
-						case REG_CONFIG: {
-							const uint32_t val = 0;
-						#if 0
+						case REG_CORRECTED: {
+							/* the decoder increments the counters outside of
+							 * this interrupt, so never write them, report the
+							 * difference to the last read instead */
+							const uint32_t burst = crc32Statistics.burst,
+									twoBit = crc32Statistics.twoBit;
 							const uint32_t val =
-									((stationGetMaxRetransmit (sta) & 0xff) << 24) |
-									((stationGetBsSlots (sta) & 0xff) << 16) |
-									((stationGetClients (sta) & 0xff) << 8) |
-									(stationGetClientId (sta) & 0xff);
-#endif
-							queueResponse (dev, &val, sizeof (val));
+									(((burst - client->correctedBurst) & 0xffff) << 16) |
+									((twoBit - client->correctedTwoBit) & 0xffff);
+							queueResponse (client, &val, sizeof (val));
+							client->correctedBurst = burst;
+							client->correctedTwoBit = twoBit;
+							break;
+						}
+
+						case REG_CONFIG:
+							queueResponse (client, &client->config,
+									sizeof (client->config));
+							break;
+
+						case REG_GROUPS:
+							queueResponse (client, &client->groups,
+									sizeof (client->groups));
+							break;
+
+						case REG_IRQPACKETS: {
+							const uint32_t val = client->irqPackets;
+							queueResponse (client, &val, sizeof (val));
+							break;
+						}
+
+						case REG_IRQTIMEOUT:
+							queueResponse (client, &client->irqTimeout,
+									sizeof (client->irqTimeout));
+							break;
+
+						case REG_DELTA:
+						case REG_CALDELTA:
+						case REG_SWITCHING:
+						case REG_AIRTIME:
+						case REG_EOMTIME:
+						case REG_DRIFT:
+						case REG_DRIFTING: {
+							fmacTiming t;
+							assert (client->getTiming != NULL);
+							client->getTiming (client->macData, &t);
+							const uint32_t val = reg == REG_DELTA ? t.delta :
+									reg == REG_CALDELTA ? t.calibrated :
+									reg == REG_SWITCHING ? t.switching :
+									reg == REG_AIRTIME ? t.airtime :
+									reg == REG_EOMTIME ? t.eom :
+									reg == REG_DRIFT ? t.drift : t.drifting;
+							queueResponse (client, &val, sizeof (val));
 							break;
 						}
+
+						default:
+							if (reg >= REG_SKEW && reg < REG_SKEW+KSET_MAX_N) {
+								int32_t ppm;
+								assert (client->getSkew != NULL);
+								if (!client->getSkew (client->macData,
+										reg-REG_SKEW, &ppm)) {
+									ppm = 0;
+								}
+								queueResponse (client, &ppm, sizeof (ppm));
+							}
+							break;
 					}
 					break;
 				}
@@ -323,15 +678,66 @@ void ISR () {
 							const uint8_t stationId = XMC_USIC_CH_RXFIFO_GetData (dev);
 							const uint8_t numStations = XMC_USIC_CH_RXFIFO_GetData (dev);
 							const uint8_t payloadSize = XMC_USIC_CH_RXFIFO_GetData (dev);
+							const uint8_t trainEncoder = XMC_USIC_CH_RXFIFO_GetData (dev);
+							const uint8_t encoder = trainEncoder >> CONFIG_ENCODER_SHIFT;
 							assert (payloadSize <= SPICLIENT_RX_ITEM_SIZE &&
 									payloadSize <= SPICLIENT_TX_ITEM_SIZE);
-							client->payloadSize = payloadSize;
-							initFifos (client);
-							debug ("configuring with i=%u, n=%u, len=%u\n", stationId,
-									numStations, payloadSize);
-							assert (client->initMac != NULL);
-							client->initMac (client->macData, stationId,
-									numStations, payloadSize);
+							if (encoder >= PACKET_ENCODER_COUNT) {
+								/* the field has room for more encoders than
+								 * exist, keep the current configuration */
+								debug ("invalid encoder %u\n", encoder);
+								break;
+							}
+							/* a train must fit into one framelet and into the
+							 * fifo, see fmacSend */
+							uint8_t train = trainEncoder & CONFIG_TRAIN_MASK;
+							const uint8_t maxTrain = fmacMaxTrain (payloadSize);
+							if (train > maxTrain) {
+								train = maxTrain;
+							}
+							if (train > SPICLIENT_FIFO_SLOTS-1) {
+								train = SPICLIENT_FIFO_SLOTS-1;
+							}
+							client->configNext = ((uint32_t) ((encoder << CONFIG_ENCODER_SHIFT) |
+									train) << 24) |
+									(payloadSize << 16) | (numStations << 8) |
+									stationId;
+							/* the main loop uses the fifos and the mac, so it
+							 * applies this, see spiclientProcess */
+							client->configPending = true;
+							break;
+						}
+
+						case REG_GROUPS: {
+							const uint32_t groups = readValue (dev);
+							client->groups = groups;
+							debug ("joining groups %x\n", groups);
+							assert (client->setGroups != NULL);
+							client->setGroups (client->macData, groups);
+							break;
+						}
+
+						case REG_IRQPACKETS: {
+							/* the fifo cannot hold more */
+							const uint32_t val = readValue (dev);
+							client->irqPackets = val < 1 ? 1 :
+									val > SPICLIENT_FIFO_SLOTS-1 ?
+									SPICLIENT_FIFO_SLOTS-1 : val;
+							break;
+						}
+
+						case REG_IRQTIMEOUT: {
+							const uint32_t val = readValue (dev);
+							client->irqTimeout = val > COALESCE_MAX_US ?
+									COALESCE_MAX_US : val;
+							break;
+						}
+
+						case REG_DELTA: {
+							const uint32_t val = readValue (dev);
+							debug ("setting delta %u\n", val);
+							assert (client->setDelta != NULL);
+							client->setDelta (client->macData, val);
 							break;
 						}
 					}
@@ -364,6 +770,15 @@ void spiclientInit (spiclient * const client, XMC_USIC_CH_t * const dev,
 	client->dev = dev;
 
 	initFifos (client);
+	client->configPending = false;
+	/* every packet wakes the host by default */
+	client->irqPackets = 1;
+	client->irqTimeout = 0;
+	client->irqAsserted = false;
+	client->correctedBurst = crc32Statistics.burst;
+	client->correctedTwoBit = crc32Statistics.twoBit;
+	/* the timer service must be running, see timerInit */
+	timerSetup (&client->timeout, timeout, client);
 
 	SEGGER_RTT_ConfigUpBuffer (1, "data", upBuffer,
 			sizeof (upBuffer), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
@@ -427,8 +842,17 @@ void spiclientInit (spiclient * const client, XMC_USIC_CH_t * const dev,
 #endif
 	/* set up fifo, always transmit immediately */
 	/* are rx and tx fifo are shared, data section for rxfifo is after txfifo (offset 32) */
-	XMC_USIC_CH_TXFIFO_Configure (dev, 0, XMC_USIC_CH_FIFO_SIZE_32WORDS, 0);
-	XMC_USIC_CH_RXFIFO_Configure (dev, 32, XMC_USIC_CH_FIFO_SIZE_32WORDS, 0);
+	XMC_USIC_CH_TXFIFO_Configure (dev, 0, XMC_USIC_CH_FIFO_SIZE_32WORDS,
+			USIC_TXFIFO_LIMIT);
+	XMC_USIC_CH_RXFIFO_Configure (dev, USIC_FIFO_SIZE,
+			XMC_USIC_CH_FIFO_SIZE_32WORDS, 0);
+	/* refill interrupt on the same service request line as the protocol
+	 * events, enabled while a response is pending */
+	XMC_USIC_CH_TXFIFO_SetInterruptNodePointer (dev,
+			XMC_USIC_CH_TXFIFO_INTERRUPT_NODE_POINTER_STANDARD, 0);
+	client->responseLen = 0;
+	client->responsePos = 0;
+	client->responseBreak = false;
 
 	/* spi client has lower priority than timer and tda */
     NVIC_SetPriority (IRQN, priority);
@@ -25,32 +25,77 @@ THE SOFTWARE.
 
 #include "fifo.h"
 #include "fmac.h"
+#include "timer.h"
 
-/* attention: item start must be aligned to 4 bytes */
-#define SPICLIENT_RX_ITEM_SIZE FMAC_MAX_PACKET_LEN
-#define SPICLIENT_TX_ITEM_SIZE FMAC_MAX_PACKET_LEN
+/* attention: item start must be aligned to 4 bytes. Items are a length byte
+ * followed by the payload, tx items have the destination in between */
+#define SPICLIENT_RX_ITEM_SIZE ((1+FMAC_MAX_PAYLOAD_LEN+3)/4*4)
+#define SPICLIENT_TX_ITEM_SIZE ((2+FMAC_MAX_PAYLOAD_LEN+3)/4*4)
+/* fifo slots, one is always kept free. Must hold a full packet train */
+#define SPICLIENT_FIFO_SLOTS (8)
+/* largest response: start and end marker, batch header and a full rx fifo */
+#define SPICLIENT_RESPONSE_SIZE (2+3+(SPICLIENT_FIFO_SLOTS-1)*(1+FMAC_MAX_PAYLOAD_LEN))
 
 typedef void (*spiclientInitMac) (void * data, const uint8_t i, const uint8_t n,
-		const uint8_t payloadSize);
+		const uint8_t payloadSize, const uint8_t train, const uint8_t encoder);
 typedef void (*spiclientTriggerSend) (void * data);
+typedef void (*spiclientSetGroups) (void * data, const uint32_t groups);
+typedef void (*spiclientGetTiming) (void * data, fmacTiming * const t);
+typedef void (*spiclientSetDelta) (void * data, const uint32_t us);
+typedef bool (*spiclientGetSkew) (void * data, const uint8_t station,
+		int32_t * const ppm);
 
 typedef struct {
 	XMC_USIC_CH_t *dev;
 	fifo rxFifo, txFifo;
+	/* max payload size */
 	uint8_t payloadSize;
+	/* last value written to the CONFIG and GROUPS registers */
+	uint32_t config, groups;
+	/* CONFIG written, but not applied by spiclientProcess yet */
+	uint32_t configNext;
+	volatile bool configPending;
 	/* backing memory for fifos */
-	uint8_t rxData[SPICLIENT_RX_ITEM_SIZE*3], txData[SPICLIENT_TX_ITEM_SIZE*3];
+	uint8_t rxData[SPICLIENT_RX_ITEM_SIZE*SPICLIENT_FIFO_SLOTS],
+			txData[SPICLIENT_TX_ITEM_SIZE*SPICLIENT_FIFO_SLOTS];
+	/* last item returned by spiclientTx */
+	uint8_t txItem[SPICLIENT_TX_ITEM_SIZE];
+	/* response being moved into the usic tx fifo, including markers */
+	uint8_t response[SPICLIENT_RESPONSE_SIZE];
+	size_t responseLen, responsePos;
+	/* uart only, break symbol still has to be sent */
+	bool responseBreak;
 	/* performance counters */
 	uint32_t overflowCount;
+	/* crc32Statistics at the last CORRECTED read */
+	uint32_t correctedBurst, correctedTwoBit;
+	/* interrupt coalescing: assert the line once irqPackets are pending or
+	 * irqTimeout μs after the first one (0 disables), hold it until the rx
+	 * fifo is drained */
+	uint8_t irqPackets;
+	uint32_t irqTimeout;
+	bool irqAsserted;
+	timer timeout;
 
 	/* glue for MAC */
 	spiclientInitMac initMac;
 	spiclientTriggerSend triggerSend;
+	spiclientSetGroups setGroups;
+	spiclientGetTiming getTiming;
+	spiclientSetDelta setDelta;
+	spiclientGetSkew getSkew;
 	void *macData;
 } spiclient;
 
 void spiclientInit (spiclient * const client, XMC_USIC_CH_t * const dev,
 		const uint32_t priority);
+void spiclientProcess (spiclient * const client);
 bool spiclientRx (void * const data, const void * const payload, const size_t size);
-bool spiclientTx (void * const data, const void ** const payload, size_t * const size);
+bool spiclientTx (void * const data, const void ** const payload,
+		size_t * const size, uint8_t * const dest);
 
+/*	A CONFIG write waits for spiclientProcess
+ */
+inline static bool spiclientPending (const spiclient * const client) {
+	return client->configPending;
+}
@@ -0,0 +1,518 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/*	Software timers on one free-running clock. Two concatenated CCU4 slices
+ *	count continuously, a third one is a one-shot alarm for the earliest
+ *	deadline. Pending timers are kept in a list sorted by deadline, which is
+ *	short: the MAC and the host interrupt timeout. Deadlines are absolute, so
+ *	interrupt latency does not add up. All pending deadlines must be within
+ *	2^31 ticks (3.5 min at 10 MHz) of each other.
+ */
+
+#include <assert.h>
+
+#include "timer.h"
+
+/* longest alarm, in ticks */
+#define ALARM_MAX (0x10000)
+
+static timerQueue queue;
+timerQueue *timerActive = &queue;
+
+#ifdef _TEST
+/* fake clock, advanced by the tests */
+static uint32_t testNow;
+/* ticks the alarm was started with, 0 if stopped */
+static uint32_t testAlarm;
+
+static uint32_t clockValue (void) {
+	return testNow;
+}
+
+static void alarmStop (void) {
+	testAlarm = 0;
+}
+
+static void alarmStart (const uint32_t ticks) {
+	testAlarm = ticks;
+}
+
+static uint32_t lock (void) {
+	return 0;
+}
+
+static void unlock (const uint32_t primask) {
+}
+#else
+#include <xmc_ccu4.h>
+
+#include "config.h"
+
+#define SLICE_CLOCK_LOWER CCU40_CC40
+#define SLICE_CLOCK_LOWER_NO (0)
+#define SLICE_CLOCK_LOWER_SHADOW XMC_CCU4_SHADOW_TRANSFER_SLICE_0
+#define SLICE_CLOCK_UPPER CCU40_CC41
+#define SLICE_CLOCK_UPPER_NO (1)
+#define SLICE_CLOCK_UPPER_SHADOW XMC_CCU4_SHADOW_TRANSFER_SLICE_1
+#define SLICE_ALARM CCU40_CC43
+#define SLICE_ALARM_NO (3)
+#define SLICE_ALARM_SHADOW XMC_CCU4_SHADOW_TRANSFER_SLICE_3
+#define MODULE_PTR        CCU40
+
+#if UC_SERIES == XMC11
+/* 64 MHz pclk */
+#define PRESCALER XMC_CCU4_SLICE_PRESCALER_16
+#elif UC_SERIES == XMC45
+/* 80 MHz fccu */
+#define PRESCALER XMC_CCU4_SLICE_PRESCALER_8
+#endif
+
+static uint32_t clockValue (void) {
+	uint16_t upper, lower;
+	/* the lower slice may overflow into the upper one in between */
+	do {
+		upper = XMC_CCU4_SLICE_GetTimerValue (SLICE_CLOCK_UPPER);
+		lower = XMC_CCU4_SLICE_GetTimerValue (SLICE_CLOCK_LOWER);
+	} while (upper != XMC_CCU4_SLICE_GetTimerValue (SLICE_CLOCK_UPPER));
+	return lower | ((uint32_t) upper << 16);
+}
+
+static void alarmStop (void) {
+	XMC_CCU4_SLICE_StopTimer (SLICE_ALARM);
+}
+
+/*	The alarm is stopped, so its period is transferred immediately
+ */
+static void alarmStart (const uint32_t ticks) {
+	XMC_CCU4_SLICE_ClearTimer (SLICE_ALARM);
+	XMC_CCU4_SLICE_SetTimerPeriodMatch (SLICE_ALARM, ticks-1);
+	XMC_CCU4_EnableShadowTransfer (MODULE_PTR, SLICE_ALARM_SHADOW);
+	XMC_CCU4_SLICE_StartTimer (SLICE_ALARM);
+}
+
+/*	Timers are started from several interrupt priorities, possibly with
+ *	interrupts disabled already
+ */
+static uint32_t lock (void) {
+	const uint32_t primask = __get_PRIMASK ();
+	__disable_irq ();
+	return primask;
+}
+
+static void unlock (const uint32_t primask) {
+	__set_PRIMASK (primask);
+}
+
+/*	Start the clock and set up the alarm, its interrupt is CCU40_0_IRQn
+ */
+void timerInit (const uint32_t priority) {
+	XMC_CCU4_SLICE_COMPARE_CONFIG_t config = {
+		.timer_mode 		     = XMC_CCU4_SLICE_TIMER_COUNT_MODE_EA,
+		/* monoshot does not work well with timer concat */
+		.monoshot   		     = XMC_CCU4_SLICE_TIMER_REPEAT_MODE_REPEAT,
+		.shadow_xfer_clear   = 0U,
+		.dither_timer_period = 0U,
+		.dither_duty_cycle   = 0U,
+		.prescaler_mode	     = XMC_CCU4_SLICE_PRESCALER_MODE_NORMAL,
+		.mcm_enable		       = 0U,
+		.prescaler_initval   = PRESCALER,
+		.float_limit		     = 0U,
+		.dither_limit		     = 0U,
+		.passive_level 	     = XMC_CCU4_SLICE_OUTPUT_PASSIVE_LEVEL_LOW,
+		.timer_concatenation = 0U
+	};
+
+	/* reinitializing */
+	XMC_CCU4_SLICE_StopTimer (SLICE_CLOCK_LOWER);
+	XMC_CCU4_SLICE_StopTimer (SLICE_CLOCK_UPPER);
+	alarmStop ();
+	timerActive->head = NULL;
+	timerActive->expired = NULL;
+
+	XMC_CCU4_SetModuleClock(MODULE_PTR, XMC_CCU4_CLOCK_SCU);
+	XMC_CCU4_Init(MODULE_PTR, XMC_CCU4_SLICE_MCMS_ACTION_TRANSFER_PR_CR);
+	XMC_CCU4_StartPrescaler(MODULE_PTR);
+
+	/* Get the slices out of idle mode */
+	XMC_CCU4_EnableClock(MODULE_PTR, SLICE_CLOCK_LOWER_NO);
+	XMC_CCU4_EnableClock(MODULE_PTR, SLICE_CLOCK_UPPER_NO);
+	XMC_CCU4_EnableClock(MODULE_PTR, SLICE_ALARM_NO);
+
+	/* Initialize the slices, the clock runs through all 32 bits */
+	XMC_CCU4_SLICE_CompareInit(SLICE_CLOCK_LOWER, &config);
+	config.timer_concatenation = 1;
+	XMC_CCU4_SLICE_CompareInit(SLICE_CLOCK_UPPER, &config);
+	config.timer_concatenation = 0;
+	config.monoshot = XMC_CCU4_SLICE_TIMER_REPEAT_MODE_SINGLE;
+	XMC_CCU4_SLICE_CompareInit(SLICE_ALARM, &config);
+
+	XMC_CCU4_SLICE_SetTimerPeriodMatch (SLICE_CLOCK_LOWER, 0xffff);
+	XMC_CCU4_SLICE_SetTimerPeriodMatch (SLICE_CLOCK_UPPER, 0xffff);
+	XMC_CCU4_EnableShadowTransfer (MODULE_PTR, SLICE_CLOCK_LOWER_SHADOW);
+	XMC_CCU4_EnableShadowTransfer (MODULE_PTR, SLICE_CLOCK_UPPER_SHADOW);
+
+	/* Configure interrupts, the alarm fires once at its period match */
+	XMC_CCU4_SLICE_EnableEvent(SLICE_ALARM,
+			XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH);
+	XMC_CCU4_SLICE_SetInterruptNode(SLICE_ALARM,
+			XMC_CCU4_SLICE_IRQ_ID_PERIOD_MATCH, XMC_CCU4_SLICE_SR_ID_0);
+	NVIC_SetPriority(CCU40_0_IRQn, priority);
+	NVIC_EnableIRQ(CCU40_0_IRQn);
+
+	XMC_CCU4_SLICE_ClearTimer (SLICE_CLOCK_LOWER);
+	XMC_CCU4_SLICE_ClearTimer (SLICE_CLOCK_UPPER);
+	XMC_CCU4_SLICE_StartTimer (SLICE_CLOCK_LOWER);
+	XMC_CCU4_SLICE_StartTimer (SLICE_CLOCK_UPPER);
+}
+#endif
+
+/*	Ticks since timerInit, wraps around
+ */
+uint32_t timerNow (void) {
+	return clockValue ();
+}
+
+/*	Fire the alarm at the earliest deadline, right away if it passed already.
+ *	Deadlines beyond the 16 bit alarm are reached in several steps.
+ */
+static void arm (void) {
+	alarmStop ();
+	const timer * const head = timerActive->head;
+	if (head == NULL) {
+		return;
+	}
+	const int32_t left = (int32_t) (head->deadline - clockValue ());
+	alarmStart (left < 1 ? 1 : (left > ALARM_MAX ? ALARM_MAX :
+			(uint32_t) left));
+}
+
+/*	Insert t after all timers with the same or an earlier deadline
+ */
+static void insert (timer * const t) {
+	timer **prev = &timerActive->head;
+	while (*prev != NULL && (int32_t) ((*prev)->deadline - t->deadline) <= 0) {
+		prev = &(*prev)->next;
+	}
+	t->next = *prev;
+	*prev = t;
+	t->pending = true;
+}
+
+static void unlink (timer * const t) {
+	timer **prev = &timerActive->head;
+	while (*prev != NULL && *prev != t) {
+		prev = &(*prev)->next;
+	}
+	if (*prev == NULL) {
+		/* expired, but its callback did not run yet */
+		prev = &timerActive->expired;
+		while (*prev != t) {
+			assert (*prev != NULL);
+			prev = &(*prev)->next;
+		}
+	}
+	*prev = t->next;
+	t->pending = false;
+}
+
+void timerSetup (timer * const t, const timerCallback cb, void * const data) {
+	assert (t != NULL);
+	assert (cb != NULL);
+
+	t->cb = cb;
+	t->data = data;
+	t->next = NULL;
+	t->pending = false;
+}
+
+/*	Fire t at clock value deadline and every period ticks after that, unless
+ *	period is zero. Restarts t if it is pending already.
+ */
+void timerStartAt (timer * const t, const uint32_t deadline,
+		const uint32_t period) {
+	assert (t != NULL && t->cb != NULL);
+
+	const uint32_t primask = lock ();
+	const timer * const head = timerActive->head;
+	if (t->pending) {
+		unlink (t);
+	}
+	t->deadline = deadline;
+	t->period = period;
+	insert (t);
+	if (timerActive->head != head || head == t) {
+		arm ();
+	}
+	unlock (primask);
+}
+
+/*	Fire t once, ticks from now
+ */
+void timerStart (timer * const t, const uint32_t ticks) {
+	timerStartAt (t, clockValue () + ticks, 0);
+}
+
+void timerStop (timer * const t) {
+	assert (t != NULL);
+
+	const uint32_t primask = lock ();
+	if (t->pending) {
+		const bool first = timerActive->head == t;
+		unlink (t);
+		if (first) {
+			arm ();
+		}
+	}
+	unlock (primask);
+}
+
+/*	Alarm interrupt, run the callbacks of all timers expired by now. Timers
+ *	started by these callbacks wait for the next alarm, even if their deadline
+ *	passed already, so they see the same interrupt latency as any other.
+ *	Periodic timers are queued again before their callback runs, so it may
+ *	stop them.
+ */
+void timerIrqHandle (void) {
+	uint32_t primask = lock ();
+	alarmStop ();
+	const uint32_t now = clockValue ();
+	timer **last = &timerActive->head;
+	while (*last != NULL && (int32_t) ((*last)->deadline - now) <= 0) {
+		last = &(*last)->next;
+	}
+	assert (timerActive->expired == NULL);
+	if (last != &timerActive->head) {
+		timerActive->expired = timerActive->head;
+		timerActive->head = *last;
+		*last = NULL;
+	}
+
+	timer *t;
+	while ((t = timerActive->expired) != NULL) {
+		timerActive->expired = t->next;
+		t->pending = false;
+		if (t->period > 0) {
+			t->deadline += t->period;
+			insert (t);
+		}
+		unlock (primask);
+		t->cb (t, t->data);
+		primask = lock ();
+	}
+	arm ();
+	unlock (primask);
+}
+
+#ifdef _TEST
+/* tests */
+#include <check.h>
+#include <string.h>
+#include <stdlib.h>
+
+typedef struct {
+	unsigned int fired;
+	uint32_t last;
+	/* restart after firing, if not zero */
+	uint32_t again;
+} testData;
+
+static void testCallback (timer * const t, void * const data) {
+	testData * const d = data;
+	++d->fired;
+	d->last = testNow;
+	if (d->again > 0) {
+		timerStart (t, d->again);
+	}
+}
+
+/*	Advance the fake clock to the alarm, as often as it is running
+ */
+static void testRun (const uint32_t until) {
+	while (testAlarm > 0 && (int32_t) (testNow + testAlarm - until) <= 0) {
+		testNow += testAlarm;
+		timerIrqHandle ();
+	}
+	testNow = until;
+}
+
+START_TEST (testOrder) {
+	timer t[3];
+	testData d[3];
+
+	memset (d, 0, sizeof (d));
+	testNow = UINT32_MAX - 1000;
+	timerActive->head = NULL;
+	for (unsigned int i = 0; i < 3; i++) {
+		timerSetup (&t[i], testCallback, &d[i]);
+	}
+	/* across the clock’s wrap around */
+	timerStart (&t[0], 3000);
+	timerStart (&t[1], 1000);
+	timerStart (&t[2], 2000);
+	fail_unless (timerActive->head == &t[1]);
+	fail_unless (testAlarm == 1000);
+	testRun (testNow + 10000);
+	for (unsigned int i = 0; i < 3; i++) {
+		fail_unless (d[i].fired == 1, "timer %u fired %u times", i, d[i].fired);
+		fail_unless (!timerPending (&t[i]));
+	}
+	fail_unless (d[1].last == UINT32_MAX - 1000 + 1000);
+	fail_unless (d[2].last == UINT32_MAX - 1000 + 2000);
+	fail_unless (d[0].last == UINT32_MAX - 1000 + 3000);
+	fail_unless (testAlarm == 0);
+} END_TEST
+
+START_TEST (testLong) {
+	timer t;
+	testData d;
+
+	memset (&d, 0, sizeof (d));
+	testNow = 0;
+	timerActive->head = NULL;
+	timerSetup (&t, testCallback, &d);
+	/* several alarms, fires exactly at the deadline */
+	timerStart (&t, 5*ALARM_MAX+123);
+	testRun (10*ALARM_MAX);
+	fail_unless (d.fired == 1);
+	fail_unless (d.last == 5*ALARM_MAX+123, "fired at %u", d.last);
+} END_TEST
+
+START_TEST (testPeriodic) {
+	timer p, o;
+	testData dp, dop;
+
+	memset (&dp, 0, sizeof (dp));
+	memset (&dop, 0, sizeof (dop));
+	testNow = 500;
+	timerActive->head = NULL;
+	timerSetup (&p, testCallback, &dp);
+	timerSetup (&o, testCallback, &dop);
+	timerStartAt (&p, 1000, 1000);
+	/* restarts itself, like the MAC */
+	dop.again = 300;
+	timerStart (&o, 300);
+	testRun (10500);
+	fail_unless (dp.fired == 10, "fired %u times", dp.fired);
+	fail_unless (dp.last == 10000);
+	fail_unless (dop.fired == 33, "fired %u times", dop.fired);
+	fail_unless (dop.last == 500+33*300);
+	timerStop (&o);
+	timerStop (&p);
+	fail_unless (timerActive->head == NULL && testAlarm == 0);
+} END_TEST
+
+START_TEST (testStop) {
+	timer t[2];
+	testData d[2];
+
+	memset (d, 0, sizeof (d));
+	testNow = 0;
+	timerActive->head = NULL;
+	timerSetup (&t[0], testCallback, &d[0]);
+	timerSetup (&t[1], testCallback, &d[1]);
+	timerStart (&t[0], 100);
+	timerStart (&t[1], 200);
+	/* stopping the first one moves the alarm */
+	timerStop (&t[0]);
+	fail_unless (testAlarm == 200);
+	/* restarting moves it back */
+	timerStart (&t[1], 50);
+	fail_unless (testAlarm == 50);
+	/* passed deadlines fire right away */
+	timerStartAt (&t[0], 0, 0);
+	fail_unless (testAlarm == 1);
+	testRun (1000);
+	fail_unless (d[0].fired == 1 && d[1].fired == 1);
+} END_TEST
+
+static timer *testVictim;
+
+static void testStopCallback (timer * const t, void * const data) {
+	testCallback (t, data);
+	timerStop (testVictim);
+}
+
+static void testNowCallback (timer * const t, void * const data) {
+	testData * const d = data;
+	++d->fired;
+	if (d->fired == 1) {
+		timerStartAt (t, testNow, 0);
+	}
+}
+
+START_TEST (testExpired) {
+	timer t[2];
+	testData d[2];
+
+	memset (d, 0, sizeof (d));
+	testNow = 0;
+	timerActive->head = NULL;
+	/* restarted from its callback at a passed deadline */
+	timerSetup (&t[0], testNowCallback, &d[0]);
+	timerStart (&t[0], 100);
+	testNow = 100;
+	timerIrqHandle ();
+	fail_unless (d[0].fired == 1);
+	fail_unless (timerPending (&t[0]) && testAlarm == 1);
+	testRun (101);
+	fail_unless (d[0].fired == 2);
+
+	/* expired together, the first one stops the second one */
+	memset (d, 0, sizeof (d));
+	timerSetup (&t[0], testStopCallback, &d[0]);
+	timerSetup (&t[1], testCallback, &d[1]);
+	testVictim = &t[1];
+	timerStart (&t[0], 10);
+	timerStart (&t[1], 10);
+	testRun (1000);
+	fail_unless (d[0].fired == 1 && d[1].fired == 0);
+	fail_unless (!timerPending (&t[1]) && timerActive->head == NULL);
+} END_TEST
+
+Suite *test() {
+	Suite *s = suite_create ("timer");
+
+	/* add generic tests */
+	TCase *tc_core = tcase_create ("generic");
+	tcase_add_test (tc_core, testOrder);
+	tcase_add_test (tc_core, testLong);
+	tcase_add_test (tc_core, testPeriodic);
+	tcase_add_test (tc_core, testStop);
+	tcase_add_test (tc_core, testExpired);
+	suite_add_tcase (s, tc_core);
+
+	return s;
+}
+
+/*	test suite runner
+ */
+int main (int argc, char **argv) {
+	int numberFailed;
+	SRunner *sr = srunner_create (test ());
+
+	srunner_run_all (sr, CK_ENV);
+	numberFailed = srunner_ntests_failed (sr);
+	srunner_free (sr);
+
+	return (numberFailed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+#endif
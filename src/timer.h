@@ -0,0 +1,75 @@
+/*
+Copyright (c) 2015–2018 Lars-Dominik Braun <lars@6xq.net>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <xmc_common.h>
+
+/* clock frequency, timer ticks per second */
+#if UC_SERIES == XMC11
+#define TIMER_FREQ (4000000)
+#elif UC_SERIES == XMC45
+#define TIMER_FREQ (10000000)
+#endif
+#define TIMER_US_TO_TICKS(us) ((us)*(TIMER_FREQ/1000000))
+/* rounds up */
+#define TIMER_TICKS_TO_US(t) (((t)+TIMER_FREQ/1000000-1)/(TIMER_FREQ/1000000))
+
+typedef struct timer timer;
+/* called from the timer interrupt, may start t again */
+typedef void (*timerCallback) (timer * const t, void * const data);
+
+struct timer {
+	/* clock value this timer fires at */
+	uint32_t deadline;
+	/* added to the deadline after firing, 0 for one-shot timers */
+	uint32_t period;
+	timerCallback cb;
+	void *data;
+	/* next pending timer */
+	timer *next;
+	bool pending;
+};
+
+/* all pending timers of one clock, sorted by deadline, and those whose
+ * callback is about to run, see timerIrqHandle */
+typedef struct {
+	timer *head, *expired;
+} timerQueue;
+
+/* the simulator runs one clock per station and switches this */
+extern timerQueue *timerActive;
+
+void timerInit (const uint32_t priority);
+uint32_t timerNow (void);
+void timerSetup (timer * const t, const timerCallback cb, void * const data);
+void timerStartAt (timer * const t, const uint32_t deadline,
+		const uint32_t period);
+void timerStart (timer * const t, const uint32_t ticks);
+void timerStop (timer * const t);
+void timerIrqHandle (void);
+
+inline static bool timerPending (const timer * const t) {
+	return t->pending;
+}